@@ -16,20 +16,30 @@
 
 #include "audio.h"
 #include "radio.h"
+#include "capture.h"
+
+const int AudioBase::RX_IQ_FIR_CHUNK;
 
 AudioBase::AudioBase(Radio *radio) :
-    speakerBuffer(65536),
+    demodQueue(DEMOD_QUEUE, PEABERRYSIZE),
+    speakerRing(SPEAKER_RING),
+    rxIqFirRe(RX_IQ_FIR_CHUNK + IQFIRSIZE),
+    rxIqFirIm(RX_IQ_FIR_CHUNK + IQFIRSIZE),
+    rxIqFirOutRe(RX_IQ_FIR_CHUNK),
+    rxIqFirOutIm(RX_IQ_FIR_CHUNK),
     captureRaw(65536),
-    captureAdj(65536)
+    captureAdj(65536),
+    spectrumPacer(PEABERRYRATE)
 {
-    speaker.samples = 0;
-    speaker.shapePos = 0;
-    transmit.samples = 0;
-    transmit.shapePos = 0;
     speakerSampleRate = DEMODRATE;
+    jitter.setRate(speakerSampleRate);
+    qreal underrunRate = radio->settings()->value("speakerUnderrunRate", 1.0).toReal();
+    radio->settings()->setValue("speakerUnderrunRate", underrunRate);
+    jitter.setUnderrunRate(underrunRate);
 
     setRxIqBal(0,1);
     setRxDcBias(0,0);
+    setRxIqFir(QVector<COMPLEX>());
 
     setShape(6);
 
@@ -42,8 +52,10 @@ AudioBase::AudioBase(Radio *radio) :
     setTransmitPhase(0);
     setTransmitGain(1);
 
-    speakerBufferIn = speakerBufferOut = speakerBufLevel = 0;
-    captureCount = capturePos = 0;
+    speakerBufLevel = 0;
+    speakerFrames = 0;
+    stampClock.start();
+    capturePos = 0;
     receiveMuteCount = 0;
     receiveMuteVolume = 0;
     receiveMuteRampDown = exp(-1.0 / (MUTE_RAMP_DOWN * PEABERRYRATE));
@@ -56,30 +68,46 @@ AudioBase::AudioBase(Radio *radio) :
     connect(radio, SIGNAL(qskChanged(int)), this, SLOT(setQsk(int)));
     connect(radio, SIGNAL(rxIqBalUpdate(qreal,qreal)), this, SLOT(setRxIqBal(qreal,qreal)));
     connect(radio, SIGNAL(rxDcBiasUpdate(qreal,qreal)), this, SLOT(setRxDcBias(qreal,qreal)));
+    connect(radio, SIGNAL(rxIqFirUpdate(QVector<COMPLEX>)), this, SLOT(setRxIqFir(QVector<COMPLEX>)));
+    connect(radio, SIGNAL(fftFpsChanged(int)), this, SLOT(setSpectrumFps(int)));
+    // Runs on the spectrum thread, only touches atomics
+    connect(radio, SIGNAL(spectrumDone(int,bool)), this, SLOT(spectrumDone(int,bool)),
+            Qt::DirectConnection);
     connect(radio, SIGNAL(txGainChanged(qreal)), this, SLOT(setTransmitGain(qreal)));
     connect(radio, SIGNAL(txPhaseChanged(qreal)), this, SLOT(setTransmitPhase(qreal)));
     connect(radio, SIGNAL(ritChanged(qint64)), this, SLOT(setRit(qint64)));
     connect(radio, SIGNAL(xitChanged(qint64)), this, SLOT(setXit(qint64)));
 }
 
-void AudioBase::updateBufAverageSize(int framesRequested, qreal alpha)
+// The next frames for a speaker callback, demodulated audio plus
+// sidetone. An underrun is made up with silence. Far over target
+// means demod got ahead, so the oldest audio is dropped back to
+// the target.
+const float *AudioBase::speakerBlock(int frames, qreal alpha)
 {
-    int bufSize;
-    if (speakerBufferIn >= speakerBufferOut) bufSize = speakerBufferIn - speakerBufferOut;
-    else bufSize = (int)speakerBufferIn + 65536 - (int)speakerBufferOut;
+    int bufSize = speakerRing.fill();
+    SpeakerStamp &stamp = speakerStamps.back();
+    stamp.ns = stampClock.nsecsElapsed();
+    stamp.frames = speakerFrames;
+    stamp.period = frames;
+    speakerStamps.publish();
+    speakerFrames += frames;
 
     #ifdef QT_DEBUG
     static int supress = 1000;
     if (!supress) {
-        if (bufSize < framesRequested) {
+        if (bufSize < frames) {
             qWarning() << "UNDERRUN bufAverageSize =" << bufAverageSize();
             supress += 50;
         }
     } else supress--;
     #endif
 
-    if (bufSize > bufAverageTarget() * 2.5) {
-        speakerBufferIn = speakerBufferOut + bufAverageTarget();
+    if (jitter.rate() != speakerSampleRate) jitter.setRate(speakerSampleRate);
+    jitter.update(bufSize, frames);
+
+    if (bufSize > jitter.overrunLevel()) {
+        speakerRing.skip(bufSize - bufAverageTarget());
         #ifdef QT_DEBUG
         if (!supress) {
             qWarning() << "OVERRUN bufAverageSize =" << bufAverageSize();
@@ -88,57 +116,219 @@ void AudioBase::updateBufAverageSize(int framesRequested, qreal alpha)
         #endif
     }
     speakerBufLevel = (1.0-alpha)*speakerBufLevel + alpha*bufSize;
-    while (bufSize < framesRequested) {
-        bufSize++;
-        speakerBuffer[speakerBufferOut--] = 0;
+
+    if (speakerIn.size() < frames) speakerIn.resize(frames);
+    float *out = speakerIn.data();
+    int got = speakerRing.read(out, frames);
+    std::fill(out + got, out + frames, 0.0f);
+
+    int tone = speaker.render(frames, speaker.volume);
+    const REAL *re = speaker.re();
+    for (int i = 0; i < tone; i++) out[i] += re[i];
+    return out;
+}
+
+// The next frames for the radio, full scale is 32767 or 1.0
+void AudioBase::transmitBlock(std::complex<qint16> *buf, int frames)
+{
+    transmitGeneric(buf, frames, 32767);
+}
+
+void AudioBase::transmitBlock(std::complex<float> *buf, int frames)
+{
+    transmitGeneric(buf, frames, 1);
+}
+
+template <class T>
+void AudioBase::transmitGeneric(std::complex<T> *buf, int frames, qreal fullScale)
+{
+    int tone = transmit.render(frames, transmit.volume * fullScale);
+    const REAL *re = transmit.re();
+    const REAL *im = transmit.im();
+    const REAL gain = txIqGain;
+    const REAL phase = txIqPhase;
+    for (int i = 0; i < tone; i++) {
+        buf[i] = std::complex<T>(im[i] * gain, re[i] + im[i] * phase);
     }
+    std::fill(buf + tone, buf + frames, std::complex<T>(0));
 }
 
-void AudioBase::sendElement(qreal keySecs, qreal txSecs)
+// Called by the receive callbacks with each block of
+// interleaved 16-bit or float I/Q.
+void AudioBase::receive(const qint16 *in, int frames)
 {
-    // Rounding errors will accumulate.
-    // Reset nco whenever we start a new tone.
-    if (!speaker.samples && !speaker.shapePos) {
-        speaker.nco = std::complex<qreal>(0.0, 1.0);
+    receiveGeneric(in, frames, 1 / 32767.0);
+}
+
+void AudioBase::receive(const float *in, int frames)
+{
+    receiveGeneric(in, frames, 1);
+}
+
+template <class T>
+void AudioBase::receiveGeneric(const T *in, int frames, REAL scale)
+{
+    if (frames <= 0) return;
+    const REAL *mute = receiveMuteGains(frames);
+    Capture::Correction c;
+    c.biasRe = rxBiasReal;
+    c.biasIm = rxBiasImag;
+    c.phase = rxIqPhase;
+    c.gain = rxIqGain;
+    // Split where the ring wraps
+    quint16 start = capturePos;
+    int done = 0;
+    while (done < frames) {
+        int len = std::min(frames - done, captureRaw.size() - capturePos);
+        Capture::convert(in + done * 2, &captureRaw[capturePos], &captureAdj[capturePos],
+                         len, scale, mute ? mute + done : NULL, c);
+        capturePos += len;
+        done += len;
     }
+    captureUpdate(start, frames);
+}
+
+// The mute ramps run per frame, so while one is active the gains
+// are worked out ahead of the conversion. Null means unity.
+const REAL *AudioBase::receiveMuteGains(int frames)
+{
+    int count = receiveMuteCount;
+    if (count <= 0 && receiveMuteVolume == 1) return NULL;
+    int down = std::min(count, frames);
+    if (down > 0) receiveMuteCount.fetchAndAddOrdered(-down);
+    if (receiveMute.size() < frames) receiveMute.resize(frames);
+    for (int i = 0; i < frames; i++) {
+        if (i < down) {
+            receiveMuteVolume *= receiveMuteRampDown;
+        } else {
+            receiveMuteVolume = 1 - receiveMuteRampUp +
+                                receiveMuteRampUp * receiveMuteVolume;
+        }
+        receiveMute[i] = receiveMuteVolume;
+    }
+    // Close enough, back to the unity fast path
+    if (receiveMuteVolume > 1 - 1e-7) receiveMuteVolume = 1;
+    return receiveMute.constData();
+}
+
+// Demod gets a copy of every PEABERRYSIZE block completed. The
+// queue only signals when Demod has drained it, so there is no
+// event per block while it's busy.
+void AudioBase::captureUpdate(quint16 pos, int frames)
+{
+    rxIqFirProcess(pos, frames);
+    // The last frame is taken to have arrived now, earlier blocks
+    // in the same callback are backed off at the nominal rate.
+    const qint64 now = stampClock.nsecsElapsed();
+    int next = PEABERRYSIZE - (pos & (PEABERRYSIZE-1));
+    for (int i = next; i <= frames; i += PEABERRYSIZE) {
+        COMPLEX *block = demodQueue.next();
+        if (!block) continue;
+        const COMPLEX *src = captureAdj.constData() + (quint16)(pos+i-PEABERRYSIZE);
+        std::copy(src, src + PEABERRYSIZE, block);
+        qint64 stamp = now - (qint64)(frames - i) * 1000000000 / PEABERRYRATE;
+        if (demodQueue.push(stamp)) emit demodReady();
+    }
+    pos += frames;
+    if (spectrumPacer.tick(frames)) {
+        emit spectrumUpdate(captureRaw.data(), captureAdj.data(), pos);
+    }
+}
+
+// Reads come a whole period at a time, so the count alone steps by
+// milliseconds. Going on from the last read's time at the nominal
+// rate is exact up to the drift over one period. Past the end of
+// that read the speaker may have stalled, so it stops there.
+qreal AudioBase::bufFramesAt(qint64 ns)
+{
+    speakerStamps.update();
+    const SpeakerStamp &stamp = speakerStamps.front();
+    qreal since = (ns - stamp.ns) * 1e-9 * speakerSampleRate;
+    return stamp.frames + std::min(since, (qreal)stamp.period);
+}
+
+void AudioBase::setSpectrumFps(int fps)
+{
+    spectrumPacer.setTargetFps(fps);
+}
+
+void AudioBase::spectrumDone(int busyUs, bool late)
+{
+    spectrumPacer.done(busyUs, late);
+}
+
+// The scalar phase/gain correction is only exact at one frequency.
+// This removes the remaining image with a widely-linear filter:
+//   y[n] = x[n-D] + sum(w[j] * conj(x[n-j]))
+// The direct path is delayed by D so the taps can be centered.
+// Work is done on split real/imaginary arrays so it vectorizes.
+void AudioBase::rxIqFirProcess(quint16 pos, int frames)
+{
+    const int hist = IQFIRSIZE - 1;
+    const int delay = IQFIRSIZE / 2;
+    REAL *xr = rxIqFirRe.data();
+    REAL *xi = rxIqFirIm.data();
+    REAL *yr = rxIqFirOutRe.data();
+    REAL *yi = rxIqFirOutIm.data();
+    rxIqFirTaps.update();
+    const IqFirTaps &taps = rxIqFirTaps.front();
+    while (frames > 0) {
+        int len = std::min(frames, RX_IQ_FIR_CHUNK);
+        for (int i = 0; i < len; i++) {
+            const COMPLEX &v = captureAdj[(quint16)(pos+i)];
+            xr[hist+i] = v.real();
+            xi[hist+i] = v.imag();
+        }
+        // The direct path is delayed even with no taps so turning
+        // the FIR on or off doesn't step the timing.
+        for (int i = 0; i < len; i++) {
+            yr[i] = xr[hist-delay+i];
+            yi[i] = xi[hist-delay+i];
+        }
+        if (taps.active) {
+            for (int j = 0; j < IQFIRSIZE; j++) {
+                const REAL wr = taps.re[j];
+                const REAL wi = taps.im[j];
+                const REAL *ar = xr + hist - j;
+                const REAL *ai = xi + hist - j;
+                for (int i = 0; i < len; i++) {
+                    yr[i] += wr * ar[i] + wi * ai[i];
+                    yi[i] += wi * ar[i] - wr * ai[i];
+                }
+            }
+        }
+        for (int i = 0; i < len; i++) {
+            captureAdj[(quint16)(pos+i)] = COMPLEX(yr[i], yi[i]);
+        }
+        // Uncorrected history for the next block
+        for (int i = 0; i < hist; i++) {
+            xr[i] = xr[len+i];
+            xi[i] = xi[len+i];
+        }
+        pos += len;
+        frames -= len;
+    }
+}
+
+void AudioBase::sendElement(qreal keySecs, qreal txSecs)
+{
+    speaker.restart();
     speaker.samples = keySecs * speakerSampleRate;
 
     if (txSecs >= 0) {
-        if (!transmit.samples && !transmit.shapePos) {
-            transmit.nco = std::complex<qreal>(0.0, 1.0);
-        }
+        transmit.restart();
         transmit.samples = txSecs * PEABERRYRATE;
         receiveMuteCount = txSecs * PEABERRYRATE +
                            mutePaddingFrames() +
-                           transmit.shape.size() / 2 +
+                           transmit.shapeSize() / 2 +
                            qskDelay / 1000.0 * PEABERRYRATE;
     }
 }
 
 void AudioBase::setShape(qreal ms)
 {
-    int size, i;
-
-    size = ms / 1000 * speakerSampleRate;
-    speaker.shape.resize(size);
-    i = 1;
-    for (auto &v : speaker.shape) {
-        v = 0.5 - 0.5 * cos(M_PI*i/(size+1));
-        ++i;
-    }
-    if (speaker.shapePos) speaker.shapePos = size;
-    else speaker.shapePos = 0;
-
-    size = ms / 1000 * PEABERRYRATE;
-    transmit.shape.resize(size);
-    i = 1;
-    for (auto &v : transmit.shape) {
-        v = 0.5 - 0.5 * cos(M_PI*i/(size+1));
-        ++i;
-    }
-    if (transmit.shapePos) transmit.shapePos = size;
-    else transmit.shapePos = 0;
-
+    speaker.setShape(ms / 1000 * speakerSampleRate);
+    transmit.setShape(ms / 1000 * PEABERRYRATE);
     setQsk(qskDelay); // for transmitPaddingUpdate
 }
 
@@ -146,7 +336,7 @@ void AudioBase::setQsk(int ms)
 {
     qskDelay = ms;
     emit transmitPaddingUpdate(transmitPaddingSecs()
-                               + transmit.shape.size() / (qreal)PEABERRYRATE / 2
+                               + transmit.shapeSize() / (qreal)PEABERRYRATE / 2
                                + qskDelay / 1000.0);
 }
 
@@ -162,6 +352,19 @@ void AudioBase::setRxIqBal(qreal phase, qreal gain)
     rxIqGain = gain;
 }
 
+void AudioBase::setRxIqFir(QVector<COMPLEX> taps)
+{
+    IqFirTaps &next = rxIqFirTaps.back();
+    next.active = false;
+    for (int j = 0; j < IQFIRSIZE; j++) {
+        COMPLEX t = j < taps.size() ? taps[j] : 0;
+        next.re[j] = t.real();
+        next.im[j] = t.imag();
+        if (t != COMPLEX(0)) next.active = true;
+    }
+    rxIqFirTaps.publish();
+}
+
 void AudioBase::setKeyerVolume(int v)
 {
     const qreal full_volume = 99;
@@ -170,8 +373,7 @@ void AudioBase::setKeyerVolume(int v)
 
 void AudioBase::setKeyerTone(int hz)
 {
-    qreal inc = 2 * M_PI * hz / speakerSampleRate;
-    speaker.clk = std::complex<qreal>(cos(inc), sin(inc));
+    speaker.setStep(2 * M_PI * hz / speakerSampleRate);
 }
 
 void AudioBase::setTransmitPower(int v)
@@ -182,8 +384,7 @@ void AudioBase::setTransmitPower(int v)
 
 void AudioBase::setTransmitTone()
 {
-    qreal inc = 2 * M_PI * (-24000 + xit - rit) / PEABERRYRATE;
-    transmit.clk = std::complex<qreal>(cos(inc), sin(inc));
+    transmit.setStep(2 * M_PI * (-24000 + xit - rit) / PEABERRYRATE);
 }
 
 void AudioBase::setTransmitPhase(qreal phase)
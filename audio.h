@@ -19,6 +19,12 @@
 
 #include <QtCore>
 #include "dsp.h"
+#include "framepacer.h"
+#include "samplering.h"
+#include "keyedtone.h"
+#include "blockqueue.h"
+#include "triplebuffer.h"
+#include "jitterbuffer.h"
 
 class AudioBase : public QObject
 {
@@ -26,6 +32,13 @@ class AudioBase : public QObject
 
 public:
     QString error;
+    // Names the speaker device for per-device settings
+    QString speakerKey;
+    // Capture blocks of PEABERRYSIZE for Demod, which
+    // drains it when demodReady() is emitted. Each is stamped
+    // with the stampClock time of its last frame.
+    BlockQueue<COMPLEX> demodQueue;
+    QElapsedTimer stampClock;
 
     inline qreal bufSampleRate() {
         return speakerSampleRate;
@@ -34,17 +47,23 @@ public:
         return speakerBufLevel;
     }
     inline qreal bufAverageTarget() {
-        return BUFFER_TARGET * speakerSampleRate;
+        return jitter.target();
     }
-    inline void bufAppend(qreal v) {
-        speakerBuffer[++speakerBufferIn]=v;
+    // Demod thread only. Frames the speaker had asked for at ns on
+    // stampClock, carried on from the last read at the nominal rate.
+    qreal bufFramesAt(qint64 ns);
+    // Demod thread only
+    inline void bufWrite(const float *data, int count) {
+        speakerRing.write(data, count);
+    }
+    inline const SampleRing &bufRing() const {
+        return speakerRing;
     }
 
 protected:
-    static constexpr qreal BUFFER_TARGET = 0.030;
+    static const int DEMOD_QUEUE = 16;
     static constexpr qreal MUTE_RAMP_DOWN = 0.0008;
     static constexpr qreal MUTE_RAMP_UP = 0.0015;
-    static constexpr int SPECTRUM_FPS = 20;
 
     explicit AudioBase(class Radio *radio);
     ~AudioBase() {}
@@ -55,28 +74,49 @@ protected:
     virtual qreal transmitPaddingSecs() {
         return 0;
     }
-    void updateBufAverageSize(int framesRequested, qreal alpha);
-
-    class Keyer {
-    public:
-        QAtomicInt samples;
-        QAtomicInt shapePos;
-        qreal volume;
-        QVector<qreal> shape;
-        std::complex<qreal> nco;
-        std::complex<qreal> clk;
-    } speaker, transmit;
-
-    QVector<qreal> speakerBuffer;
-    QAtomicInteger<quint16> speakerBufferIn;
-    quint16 speakerBufferOut;
+    const float *speakerBlock(int frames, qreal alpha);
+    void transmitBlock(std::complex<qint16> *buf, int frames);
+    void transmitBlock(std::complex<float> *buf, int frames);
+    void receive(const qint16 *in, int frames);
+    void receive(const float *in, int frames);
+
+    KeyedTone speaker, transmit;
+
+    // Demodulated audio, the demod thread writes and
+    // the speaker callback reads.
+    static const int SPEAKER_RING = 65536;
+    SampleRing speakerRing;
+    QVector<float> speakerIn;
     qreal speakerSampleRate;
     qreal speakerBufLevel;
+    // When each speaker read happened, for clock drift
+    struct SpeakerStamp {
+        SpeakerStamp() : ns(0), frames(0), period(0) {}
+        qint64 ns;
+        qint64 frames;
+        int period;
+    };
+    TripleBuffer<SpeakerStamp> speakerStamps;
+    qint64 speakerFrames;
+    JitterBuffer jitter;
 
     qreal rxBiasReal;
     qreal rxBiasImag;
     qreal rxIqPhase;
     qreal rxIqGain;
+    // Taps are set from the io thread while capture is running,
+    // so a whole set is handed over at a time.
+    struct IqFirTaps {
+        IqFirTaps() : active(false) {}
+        bool active;
+        REAL re[IQFIRSIZE];
+        REAL im[IQFIRSIZE];
+    };
+    TripleBuffer<IqFirTaps> rxIqFirTaps;
+    QVector<REAL> rxIqFirRe;
+    QVector<REAL> rxIqFirIm;
+    QVector<REAL> rxIqFirOutRe;
+    QVector<REAL> rxIqFirOutIm;
 
     int txPower;
     qreal txIqPhase;
@@ -87,18 +127,19 @@ protected:
     QVector<COMPLEX> captureRaw;
     QVector<COMPLEX> captureAdj;
     quint16 capturePos;
-    int captureCount;
+    FramePacer spectrumPacer;
 
     QAtomicInt receiveMuteCount;
     qreal receiveMuteVolume;
     qreal receiveMuteRampDown;
     qreal receiveMuteRampUp;
+    QVector<REAL> receiveMute;
 
     int qskDelay;
 
 signals:
     void spectrumUpdate(COMPLEX *rawData, COMPLEX *adjustedData, quint16 pos);
-    void demodUpdate(COMPLEX *data);
+    void demodReady();
     void transmitPaddingUpdate(qreal secs);
 
 public slots:
@@ -108,6 +149,9 @@ public slots:
 
     void setRxDcBias(qreal re, qreal im);
     void setRxIqBal(qreal phase, qreal gain);
+    void setRxIqFir(QVector<COMPLEX> taps);
+    void setSpectrumFps(int fps);
+    void spectrumDone(int busyUs, bool late);
 
     void setKeyerVolume(int v);
     void setKeyerTone(int hz);
@@ -119,6 +163,12 @@ public slots:
     void setRit(qint64 f);
 
 private:
+    static const int RX_IQ_FIR_CHUNK = 512;
+    template <class T> void receiveGeneric(const T *in, int frames, REAL scale);
+    template <class T> void transmitGeneric(std::complex<T> *buf, int frames, qreal fullScale);
+    const REAL *receiveMuteGains(int frames);
+    void captureUpdate(quint16 pos, int frames);
+    void rxIqFirProcess(quint16 pos, int frames);
     void computeTransmitVolume();
     void setTransmitTone();
 
@@ -128,6 +178,8 @@ private:
 #include "audio_win.h"
 #elif defined(Q_OS_MAC)
 #include "audio_osx.h"
+#elif defined(Q_OS_UNIX)
+#include "audio_linux.h"
 #endif
 
 #endif // AUDIO_H
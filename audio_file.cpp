@@ -0,0 +1,339 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "audio_file.h"
+#include "radio.h"
+#include <QtEndian>
+#include <cstring>
+
+static inline qint16 toInt16(qreal v)
+{
+    return qBound(-1.0, v, 1.0) * 32767;
+}
+
+AudioFile::AudioFile(Radio *radio, const QStringList &args) :
+    AudioBase(radio),
+    inputFormat(Format::Int16),
+    m_fast(args.contains("--iq-fast")),
+    worker(NULL)
+{
+    // Friendly error prefixes
+    static const QString ERROR_INPUT = QString("I/Q input ");
+    static const QString ERROR_SPEAKER = QString("Speaker output ");
+    static const QString ERROR_TRANSMIT = QString("Transmit output ");
+
+    // Opening a named pipe waits here for the writer
+    QString path = argument(args, "--iq-input");
+    input.setFileName(path);
+    if (!input.open(QIODevice::ReadOnly)) {
+        error = ERROR_INPUT + path + ": " + input.errorString();
+        return;
+    }
+    if (args.contains("--iq-float")) inputFormat = Format::Float;
+    char head[12];
+    if (input.peek(head, sizeof(head)) == sizeof(head) &&
+            !memcmp(head, "RIFF", 4) && !memcmp(head + 8, "WAVE", 4)) {
+        if (!readWavHeader()) {
+            error = ERROR_INPUT + path + " must be 2 channel 96 kHz 16-bit or float WAV.";
+            return;
+        }
+    }
+
+    openOutput(speakerOut, argument(args, "--speaker-output"), 1, speakerSampleRate,
+               ERROR_SPEAKER);
+    if (!error.isEmpty()) return;
+    // Paced from the input, so never drifts
+    speakerKey = "File";
+    openOutput(transmitOut, argument(args, "--transmit-output"), 2, PEABERRYRATE,
+               ERROR_TRANSMIT);
+    if (!error.isEmpty()) return;
+    QString text = argument(args, "--transmit-text");
+    if (transmitOut.file.isOpen() && text.isEmpty()) {
+        error = ERROR_TRANSMIT + "needs --transmit-text to key it.";
+        return;
+    }
+    bool wpmOK;
+    int wpm = argument(args, "--transmit-wpm").toInt(&wpmOK);
+    buildScript(text, wpmOK ? qBound(5, wpm, 60) : 20);
+
+    // The worker is blocked while Spectrum works on a fast frame,
+    // so corrections set from that thread land between blocks.
+    if (m_fast) {
+        spectrumPacer.setFixedFps(FAST_FPS);
+        disconnect(radio, SIGNAL(rxIqBalUpdate(qreal,qreal)), this, SLOT(setRxIqBal(qreal,qreal)));
+        disconnect(radio, SIGNAL(rxDcBiasUpdate(qreal,qreal)), this, SLOT(setRxDcBias(qreal,qreal)));
+        disconnect(radio, SIGNAL(rxIqFirUpdate(QVector<COMPLEX>)),
+                   this, SLOT(setRxIqFir(QVector<COMPLEX>)));
+        connect(radio, SIGNAL(rxIqBalUpdate(qreal,qreal)), this, SLOT(setRxIqBal(qreal,qreal)),
+                Qt::DirectConnection);
+        connect(radio, SIGNAL(rxDcBiasUpdate(qreal,qreal)), this, SLOT(setRxDcBias(qreal,qreal)),
+                Qt::DirectConnection);
+        connect(radio, SIGNAL(rxIqFirUpdate(QVector<COMPLEX>)),
+                this, SLOT(setRxIqFir(QVector<COMPLEX>)), Qt::DirectConnection);
+    }
+
+    // A fast worker can be waiting on demod or spectrum,
+    // so it must finish before their threads do.
+    connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()),
+            this, SLOT(finish()), Qt::DirectConnection);
+}
+
+AudioFile::~AudioFile()
+{
+    closeOutput(speakerOut);
+    closeOutput(transmitOut);
+}
+
+QString AudioFile::argument(const QStringList &args, const QString &name)
+{
+    int i = args.indexOf(name);
+    if (i < 0 || i + 1 >= args.size()) return QString();
+    return args.at(i + 1);
+}
+
+bool AudioFile::requested(const QStringList &args)
+{
+    return !argument(args, "--iq-input").isEmpty();
+}
+
+// Standard timing, a dah is three dits with one between elements,
+// three between characters and seven between words. Characters
+// without a code are taken as spaces.
+void AudioFile::buildScript(const QString &text, int wpm)
+{
+    static const char *const letters[26] = {
+        ".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..",
+        ".---", "-.-", ".-..", "--", "-.", "---", ".--.", "--.-", ".-.",
+        "...", "-", "..-", "...-", ".--", "-..-", "-.--", "--.."
+    };
+    static const char *const digits[10] = {
+        "-----", ".----", "..---", "...--", "....-",
+        ".....", "-....", "--...", "---..", "----."
+    };
+    const qreal ditSecs = 1.2 / wpm;
+    const qint64 dit = ditSecs * PEABERRYRATE;
+    qint64 frame = 0;
+    script.clear();
+    QByteArray chars = text.toUpper().toLatin1();
+    for (int i = 0; i < chars.size(); ++i) {
+        char c = chars.at(i);
+        const char *code = NULL;
+        if (c >= 'A' && c <= 'Z') code = letters[c - 'A'];
+        else if (c >= '0' && c <= '9') code = digits[c - '0'];
+        else if (c == '/') code = "-..-.";
+        else if (c == '?') code = "..--..";
+        else if (c == '.') code = ".-.-.-";
+        else if (c == ',') code = "--..--";
+        else if (c == '=') code = "-...-";
+        if (!code) {
+            if (!script.isEmpty()) frame += 4 * dit;
+            continue;
+        }
+        for (; *code; ++code) {
+            int len = (*code == '-') ? 3 : 1;
+            Element e;
+            e.start = frame;
+            e.secs = len * ditSecs;
+            script.append(e);
+            frame += (len + 1) * dit;
+        }
+        frame += 2 * dit;
+    }
+}
+
+// Pipes can't seek so chunks are read through to the data.
+bool AudioFile::readWavHeader()
+{
+    uchar head[12];
+    if (readFully((char*)head, sizeof(head)) != sizeof(head)) return false;
+    bool formatOK = false;
+    for (;;) {
+        uchar chunk[8];
+        if (readFully((char*)chunk, sizeof(chunk)) != sizeof(chunk)) return false;
+        quint32 size = qFromLittleEndian<quint32>(chunk + 4);
+        if (!memcmp(chunk, "data", 4)) return formatOK;
+        QByteArray body(size + (size & 1), 0);
+        if (readFully(body.data(), body.size()) != body.size()) return false;
+        if (!memcmp(chunk, "fmt ", 4) && size >= 16) {
+            const uchar *fmt = (const uchar*)body.constData();
+            quint16 tag = qFromLittleEndian<quint16>(fmt);
+            quint16 channels = qFromLittleEndian<quint16>(fmt + 2);
+            quint32 rate = qFromLittleEndian<quint32>(fmt + 4);
+            quint16 bits = qFromLittleEndian<quint16>(fmt + 14);
+            // WAVE_FORMAT_EXTENSIBLE keeps the tag in the subformat
+            if (tag == 0xFFFE && size >= 26) tag = qFromLittleEndian<quint16>(fmt + 24);
+            if (channels != 2 || rate != PEABERRYRATE) return false;
+            if (tag == 1 && bits == 16) inputFormat = Format::Int16;
+            else if (tag == 3 && bits == 32) inputFormat = Format::Float;
+            else return false;
+            formatOK = true;
+        }
+    }
+}
+
+// Pipes return whatever the writer has sent so far
+qint64 AudioFile::readFully(char *data, qint64 size)
+{
+    qint64 got = 0;
+    while (got < size) {
+        qint64 n = input.read(data + got, size - got);
+        if (n <= 0) break;
+        got += n;
+    }
+    return got;
+}
+
+void AudioFile::openOutput(Output &out, const QString &path, int channels, int rate,
+                           const QString &errstr)
+{
+    if (path.isEmpty()) return;
+    out.file.setFileName(path);
+    if (!out.file.open(QIODevice::WriteOnly)) {
+        error = errstr + path + ": " + out.file.errorString();
+        return;
+    }
+    out.channels = channels;
+    out.rate = rate;
+    out.wav = path.endsWith(".wav", Qt::CaseInsensitive);
+    if (out.wav) writeWavHeader(out);
+}
+
+void AudioFile::writeWavHeader(Output &out)
+{
+    uchar h[44];
+    quint16 blockAlign = out.channels * sizeof(qint16);
+    memcpy(h, "RIFF", 4);
+    qToLittleEndian<quint32>(36 + out.dataBytes, h + 4);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, h + 16);
+    qToLittleEndian<quint16>(1, h + 20);
+    qToLittleEndian<quint16>(out.channels, h + 22);
+    qToLittleEndian<quint32>(out.rate, h + 24);
+    qToLittleEndian<quint32>(out.rate * blockAlign, h + 28);
+    qToLittleEndian<quint16>(blockAlign, h + 32);
+    qToLittleEndian<quint16>(16, h + 34);
+    memcpy(h + 36, "data", 4);
+    qToLittleEndian<quint32>(out.dataBytes, h + 40);
+    out.file.write((const char*)h, sizeof(h));
+}
+
+void AudioFile::writeOutput(Output &out, const void *data, qint64 bytes)
+{
+    if (!out.file.isOpen()) return;
+    out.file.write((const char*)data, bytes);
+    out.dataBytes += bytes;
+}
+
+// Sizes are filled in once they're known. A pipe keeps the
+// streaming header, most readers accept it.
+void AudioFile::closeOutput(Output &out)
+{
+    if (!out.file.isOpen()) return;
+    if (out.wav && !out.file.isSequential() && out.file.seek(0)) writeWavHeader(out);
+    out.file.close();
+}
+
+
+void AudioFile::start()
+{
+    worker = new AudioFileThread(this);
+    worker->start(QThread::TimeCriticalPriority);
+}
+
+void AudioFile::stop()
+{
+    finish();
+    delete worker;
+    worker = NULL;
+    closeOutput(speakerOut);
+    closeOutput(transmitOut);
+}
+
+void AudioFile::finish()
+{
+    if (!worker) return;
+    worker->running = false;
+    worker->wait();
+}
+
+
+// Every period is received, transmitted and played in turn
+// so the simulated devices share one clock.
+void AudioFileThread::run()
+{
+    const int speakerFrames = AudioFile::PERIOD * audio->speakerSampleRate / PEABERRYRATE;
+    QElapsedTimer clock;
+    qint64 frames = 0;
+    running = true;
+    clock.start();
+
+    while (running && doReceive(AudioFile::PERIOD)) {
+        doKeying(frames);
+        doTransmit(AudioFile::PERIOD);
+        doSpeaker(speakerFrames);
+        frames += AudioFile::PERIOD;
+        if (!audio->m_fast) {
+            qint64 aheadUs = frames * 1000000 / PEABERRYRATE - clock.nsecsElapsed() / 1000;
+            if (aheadUs > 0) usleep(aheadUs);
+        }
+    }
+
+    if (running) {
+        qDebug() << "end of I/Q input after" << frames / (qreal)PEABERRYRATE << "seconds";
+        QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+    }
+}
+
+// False at the end of the input, a partial period
+// is still delivered.
+bool AudioFileThread::doReceive(int frames)
+{
+    bool isFloat = audio->inputFormat == AudioFile::Format::Float;
+    int frameBytes = isFloat ? 2 * sizeof(float) : 2 * sizeof(qint16);
+    inBuf.resize(frames * frameBytes);
+    int got = audio->readFully(inBuf.data(), inBuf.size()) / frameBytes;
+    if (isFloat) audio->receive((const float*)inBuf.constData(), got);
+    else audio->receive((const qint16*)inBuf.constData(), got);
+    return got == frames;
+}
+
+// Elements are keyed on the first period at or after their start
+void AudioFileThread::doKeying(qint64 frames)
+{
+    const QVector<AudioFile::Element> &script = audio->script;
+    while (scriptPos < script.size() && script[scriptPos].start <= frames) {
+        audio->sendElement(script[scriptPos].secs, script[scriptPos].secs);
+        ++scriptPos;
+    }
+}
+
+// The speaker and transmit state advance even with no output file
+// so a run behaves the same whatever is recorded.
+void AudioFileThread::doSpeaker(int frames)
+{
+    const float *rx = audio->speakerBlock(frames, AudioFile::BUFLEVEL_ALPHA);
+    speakerBuf.resize(frames);
+    for (int i = 0; i < frames; i++) speakerBuf[i] = toInt16(rx[i]);
+    audio->writeOutput(audio->speakerOut, speakerBuf.constData(), frames * sizeof(qint16));
+}
+
+void AudioFileThread::doTransmit(int frames)
+{
+    transmitBuf.resize(frames);
+    audio->transmitBlock(transmitBuf.data(), frames);
+    audio->writeOutput(audio->transmitOut, transmitBuf.constData(),
+                       frames * sizeof(std::complex<qint16>));
+}
@@ -0,0 +1,134 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AUDIO_FILE_H
+#define AUDIO_FILE_H
+
+#include "audio.h"
+
+// Runs the radio without hardware. 96 kHz I/Q comes from a WAV or
+// raw file, or a named pipe, and the speaker and transmit audio go
+// to files. The clock is the count of input frames. Realtime pacing
+// sleeps to hold that clock to the wall clock, fast mode runs as
+// fast as demod and spectrum keep up. The application quits at the
+// end of the input.
+//
+// Fast runs are repeatable. Spectrum frames come FAST_FPS times
+// per second of input, and the receive corrections from each frame
+// start on the block after it. Realtime runs take them as they
+// arrive.
+//
+//   --iq-input PATH        WAV (16-bit or float) or raw 16-bit I/Q
+//   --iq-float             raw input is 32-bit float
+//   --iq-fast              don't pace to the wall clock
+//   --speaker-output PATH  16-bit mono at the demod rate
+//   --transmit-output PATH 16-bit I/Q at 96 kHz
+//   --transmit-text TEXT   sent in Morse from the start of the input
+//   --transmit-wpm N       speed of the text, default 20
+//
+// Outputs named *.wav get a header, anything else is raw. Transmit
+// output needs text, there's no key without the radio.
+
+class AudioFile : public AudioBase
+{
+    friend class AudioFileThread;
+    Q_OBJECT
+public:
+    explicit AudioFile(class Radio *radio, const QStringList &args);
+    ~AudioFile();
+    static bool requested(const QStringList &args);
+    bool fast() const {
+        return m_fast;
+    }
+
+private:
+    static constexpr qreal BUFLEVEL_ALPHA = 0.0005;
+    // Frames per simulated device period
+    static const int PERIOD = 192;
+    // Spectrum frames per second of input in fast mode
+    static const int FAST_FPS = 20;
+
+    enum class Format : int {
+        Int16=0,
+        Float
+    };
+
+    // Key down at this input frame for this long
+    struct Element {
+        qint64 start;
+        qreal secs;
+    };
+
+    struct Output {
+        Output() : channels(0), rate(0), wav(false), dataBytes(0) {}
+        QFile file;
+        int channels;
+        int rate;
+        bool wav;
+        quint32 dataBytes;
+    };
+
+    static QString argument(const QStringList &args, const QString &name);
+    bool readWavHeader();
+    qint64 readFully(char *data, qint64 size);
+    void openOutput(Output &out, const QString &path, int channels, int rate,
+                    const QString &errstr);
+    void writeWavHeader(Output &out);
+    void writeOutput(Output &out, const void *data, qint64 bytes);
+    void closeOutput(Output &out);
+    void buildScript(const QString &text, int wpm);
+
+public slots:
+    void start();
+    void stop();
+    void finish();
+
+private:
+    QFile input;
+    Format inputFormat;
+    bool m_fast;
+    Output speakerOut;
+    Output transmitOut;
+    QVector<Element> script;
+
+    class AudioFileThread *worker;
+};
+
+
+class AudioFileThread : public QThread
+{
+    Q_OBJECT
+public:
+    AudioFileThread(AudioFile *audio) :
+        QThread(audio),
+        audio(audio),
+        scriptPos(0) {}
+    ~AudioFileThread() {}
+    bool running;
+private:
+    AudioFile *audio;
+    void run();
+    bool doReceive(int frames);
+    void doKeying(qint64 frames);
+    void doSpeaker(int frames);
+    void doTransmit(int frames);
+    QVector<char> inBuf;
+    QVector<qint16> speakerBuf;
+    QVector<std::complex<qint16>> transmitBuf;
+    int scriptPos;
+};
+
+#endif // AUDIO_FILE_H
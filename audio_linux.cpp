@@ -0,0 +1,428 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "audio_linux.h"
+#include "radio.h"
+#include <QSettings>
+#include <cstring>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+
+const int AudioWorkerThread::RT_PRIORITY;
+
+// Error handling ALSA-style, err holds the last result.
+#define EXIT_ON_ERR(msg) if (err < 0) { error = errstr + msg + ": " + snd_strerror(err); return; }
+
+// Many speaker output formats are supported with a generic
+static const quint8 SPEAKER_UNKNOWN = 0;
+static const quint8 SPEAKER_INT16_MONO = 1;
+class AudioSpeakerInt16Mono {
+    qint16 data;
+public:
+    inline AudioSpeakerInt16Mono& operator=(qreal v) {
+        data = v * 32767;
+        return *this;
+    }
+};
+static const quint8 SPEAKER_INT16_STEREO = 2;
+class AudioSpeakerInt16Stereo {
+    qint16 left, right;
+public:
+    inline AudioSpeakerInt16Stereo& operator=(qreal v) {
+        left = right = v * 32767;
+        return *this;
+    }
+};
+static const quint8 SPEAKER_FLOAT_MONO = 3;
+class AudioSpeakerFloatMono {
+    float data;
+public:
+    inline AudioSpeakerFloatMono& operator=(qreal v) {
+        data = v;
+        return *this;
+    }
+};
+static const quint8 SPEAKER_FLOAT_STEREO = 4;
+class AudioSpeakerFloatStereo {
+    float left, right;
+public:
+    inline AudioSpeakerFloatStereo& operator=(qreal v) {
+        left = right = v;
+        return *this;
+    }
+};
+
+
+Audio::Audio(Radio *radio) :
+    AudioBase(radio),
+    speakerFormat(SPEAKER_UNKNOWN),
+    worker(NULL)
+{
+    // Friendly error prefixes
+    static const QString ERROR_SPEAKER = QString("Sound playback ");
+    static const QString ERROR_RECEIVE = QString("Peaberry Radio recording ");
+    static const QString ERROR_TRANSMIT = QString("Peaberry Radio playback ");
+
+    // Ensure settings are saved for easy user editing
+    QString speakerName = radio->settings()->value("alsaSpeaker", "default").toString();
+    radio->settings()->setValue("alsaSpeaker", speakerName);
+    speakerKey = speakerName;
+    QString peaberryName = radio->settings()->value("alsaPeaberry", "").toString();
+    radio->settings()->setValue("alsaPeaberry", peaberryName);
+    if (peaberryName.isEmpty()) peaberryName = findPeaberry();
+    if (peaberryName.isEmpty()) {
+        error = ERROR_RECEIVE + "device not found.";
+        return;
+    }
+
+    openPcm(receivePcm, peaberryName, true, true, ERROR_RECEIVE);
+    if (!error.isEmpty()) return;
+    qDebug() << "receive" << peaberryName << "mmap=" << receivePcm.mmap
+             << "periodFrames=" << receivePcm.periodFrames
+             << "bufferFrames=" << receivePcm.bufferFrames;
+
+    openPcm(transmitPcm, peaberryName, false, true, ERROR_TRANSMIT);
+    if (!error.isEmpty()) return;
+    qDebug() << "transmit" << peaberryName << "mmap=" << transmitPcm.mmap
+             << "periodFrames=" << transmitPcm.periodFrames
+             << "bufferFrames=" << transmitPcm.bufferFrames;
+
+    openPcm(speakerPcm, speakerName, false, false, ERROR_SPEAKER);
+    if (!error.isEmpty()) return;
+    qDebug() << "speaker" << speakerName << "mmap=" << speakerPcm.mmap
+             << "periodFrames=" << speakerPcm.periodFrames
+             << "bufferFrames=" << speakerPcm.bufferFrames
+             << "speakerSampleRate=" << speakerSampleRate
+             << "speakerFormat=" << speakerFormat;
+}
+
+
+Audio::~Audio()
+{
+    if (transmitPcm.handle) snd_pcm_close(transmitPcm.handle);
+    if (receivePcm.handle) snd_pcm_close(receivePcm.handle);
+    if (speakerPcm.handle) snd_pcm_close(speakerPcm.handle);
+}
+
+int Audio::mutePaddingFrames()
+{
+    // Everything queued for transmit plus a receive period
+    return transmitPcm.bufferFrames +
+           receivePcm.periodFrames +
+           0.004 * PEABERRYRATE;
+}
+
+qreal Audio::transmitPaddingSecs()
+{
+    return (qreal)transmitPcm.bufferFrames / PEABERRYRATE;
+}
+
+// USB audio cards are named after the product string
+QString Audio::findPeaberry()
+{
+    int card = -1;
+    while (snd_card_next(&card) == 0 && card >= 0) {
+        char *name = NULL;
+        if (snd_card_get_name(card, &name) < 0) continue;
+        bool found = QString(name).contains(QStringLiteral("Peaberry"));
+        free(name);
+        if (found) return QString("hw:%1,0").arg(card);
+    }
+    return QString();
+}
+
+// Mmap access is preferred, plugins without it fall back to
+// read/write through a scratch buffer.
+void Audio::openPcm(Pcm &p, const QString &device, bool capture, bool isRadio,
+                    const QString &errstr)
+{
+    int err;
+    snd_pcm_hw_params_t *hw;
+    snd_pcm_sw_params_t *sw;
+    snd_pcm_hw_params_alloca(&hw);
+    snd_pcm_sw_params_alloca(&sw);
+    snd_pcm_format_t format = SND_PCM_FORMAT_S16;
+    unsigned int channels = 2;
+    unsigned int rate = PEABERRYRATE;
+    snd_pcm_uframes_t periodFrames, bufferFrames;
+
+    p.capture = capture;
+    p.mmap = true;
+    p.offset = 0;
+    err = snd_pcm_open(&p.handle, device.toLocal8Bit().constData(),
+                       capture ? SND_PCM_STREAM_CAPTURE : SND_PCM_STREAM_PLAYBACK,
+                       SND_PCM_NONBLOCK);
+    if (err < 0) p.handle = NULL;
+    EXIT_ON_ERR("device " + device + " not opened");
+
+    err = snd_pcm_hw_params_any(p.handle, hw);
+    EXIT_ON_ERR("snd_pcm_hw_params_any");
+    err = snd_pcm_hw_params_set_access(p.handle, hw, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+    if (err < 0) {
+        p.mmap = false;
+        err = snd_pcm_hw_params_set_access(p.handle, hw, SND_PCM_ACCESS_RW_INTERLEAVED);
+    }
+    EXIT_ON_ERR("snd_pcm_hw_params_set_access");
+
+    if (isRadio) {
+        if (snd_pcm_hw_params_test_format(p.handle, hw, format) < 0 ||
+                snd_pcm_hw_params_test_channels(p.handle, hw, channels) < 0 ||
+                snd_pcm_hw_params_test_rate(p.handle, hw, rate, 0) < 0) {
+            error = errstr + "device does not support expected format.";
+            return;
+        }
+    } else {
+        const unsigned int sampleRates[] = {48000, 44100, 96000, 24000, 88200, 192000};
+        const snd_pcm_format_t formats[] = {SND_PCM_FORMAT_FLOAT, SND_PCM_FORMAT_S16};
+        bool found = false;
+        for (unsigned int r : sampleRates) {
+            for (unsigned int c = 1; c < 3; c++) {
+                for (snd_pcm_format_t f : formats) {
+                    if (!found &&
+                            snd_pcm_hw_params_test_rate(p.handle, hw, r, 0) == 0 &&
+                            snd_pcm_hw_params_test_channels(p.handle, hw, c) == 0 &&
+                            snd_pcm_hw_params_test_format(p.handle, hw, f) == 0) {
+                        rate = r;
+                        channels = c;
+                        format = f;
+                        found = true;
+                    }
+                }
+            }
+        }
+        if (!found) {
+            error = errstr + "formats not supported.";
+            return;
+        }
+        if (format == SND_PCM_FORMAT_S16) {
+            speakerFormat = channels == 1 ? SPEAKER_INT16_MONO : SPEAKER_INT16_STEREO;
+        } else {
+            speakerFormat = channels == 1 ? SPEAKER_FLOAT_MONO : SPEAKER_FLOAT_STEREO;
+        }
+        speakerSampleRate = rate;
+    }
+
+    err = snd_pcm_hw_params_set_format(p.handle, hw, format);
+    EXIT_ON_ERR("snd_pcm_hw_params_set_format");
+    err = snd_pcm_hw_params_set_channels(p.handle, hw, channels);
+    EXIT_ON_ERR("snd_pcm_hw_params_set_channels");
+    err = snd_pcm_hw_params_set_rate(p.handle, hw, rate, 0);
+    EXIT_ON_ERR("snd_pcm_hw_params_set_rate");
+
+    int periods = capture ? RECEIVE_PERIODS : isRadio ? TRANSMIT_PERIODS : SPEAKER_PERIODS;
+    periodFrames = rate * (isRadio ? RADIO_PERIOD : SPEAKER_PERIOD);
+    err = snd_pcm_hw_params_set_period_size_near(p.handle, hw, &periodFrames, NULL);
+    EXIT_ON_ERR("snd_pcm_hw_params_set_period_size_near");
+    bufferFrames = periodFrames * periods;
+    err = snd_pcm_hw_params_set_buffer_size_near(p.handle, hw, &bufferFrames);
+    EXIT_ON_ERR("snd_pcm_hw_params_set_buffer_size_near");
+    err = snd_pcm_hw_params(p.handle, hw);
+    EXIT_ON_ERR("snd_pcm_hw_params");
+    snd_pcm_hw_params_get_period_size(hw, &p.periodFrames, NULL);
+    snd_pcm_hw_params_get_buffer_size(hw, &p.bufferFrames);
+
+    // Playback starts once the worker has filled the buffer,
+    // capture is started by the worker.
+    err = snd_pcm_sw_params_current(p.handle, sw);
+    EXIT_ON_ERR("snd_pcm_sw_params_current");
+    err = snd_pcm_sw_params_set_avail_min(p.handle, sw, p.periodFrames);
+    EXIT_ON_ERR("snd_pcm_sw_params_set_avail_min");
+    if (!capture) {
+        err = snd_pcm_sw_params_set_start_threshold(p.handle, sw, p.bufferFrames);
+        EXIT_ON_ERR("snd_pcm_sw_params_set_start_threshold");
+    }
+    err = snd_pcm_sw_params(p.handle, sw);
+    EXIT_ON_ERR("snd_pcm_sw_params");
+
+    if (!p.mmap) p.scratch.resize(snd_pcm_frames_to_bytes(p.handle, p.bufferFrames));
+}
+
+snd_pcm_sframes_t Audio::avail(Pcm &p)
+{
+    snd_pcm_sframes_t frames = snd_pcm_avail_update(p.handle);
+    if (frames < 0) {
+        recover(p, frames);
+        return 0;
+    }
+    return frames;
+}
+
+// Returns where to read or write up to frames, which is reduced
+// to what is contiguous. NULL after an xrun.
+void *Audio::transferBegin(Pcm &p, snd_pcm_uframes_t &frames)
+{
+    if (p.mmap) {
+        const snd_pcm_channel_area_t *areas;
+        int err = snd_pcm_mmap_begin(p.handle, &areas, &p.offset, &frames);
+        if (err < 0) {
+            recover(p, err);
+            return NULL;
+        }
+        return (char*)areas[0].addr + areas[0].first / 8 + p.offset * areas[0].step / 8;
+    }
+    frames = std::min(frames, p.bufferFrames);
+    if (p.capture) {
+        snd_pcm_sframes_t n = snd_pcm_readi(p.handle, p.scratch.data(), frames);
+        if (n < 0) {
+            recover(p, n);
+            return NULL;
+        }
+        frames = n;
+    }
+    return p.scratch.data();
+}
+
+bool Audio::transferEnd(Pcm &p, snd_pcm_uframes_t frames)
+{
+    snd_pcm_sframes_t n;
+    if (p.mmap) n = snd_pcm_mmap_commit(p.handle, p.offset, frames);
+    else if (p.capture) return true;
+    else n = snd_pcm_writei(p.handle, p.scratch.constData(), frames);
+    if (n < 0) {
+        recover(p, n);
+        return false;
+    }
+    return true;
+}
+
+void Audio::recover(Pcm &p, int err)
+{
+    #ifdef QT_DEBUG
+    qWarning() << (p.capture ? "OVERRUN" : "UNDERRUN") << snd_strerror(err);
+    #endif
+    err = snd_pcm_recover(p.handle, err, 1);
+    if (err < 0) qWarning() << "snd_pcm_recover" << snd_strerror(err);
+    else if (p.capture) snd_pcm_start(p.handle);
+}
+
+
+void Audio::start()
+{
+    worker = new AudioWorkerThread(this);
+    worker->start(QThread::TimeCriticalPriority);
+}
+
+void Audio::stop()
+{
+    worker->running = false;
+    worker->quit();
+    worker->wait();
+    delete worker;
+}
+
+
+// SCHED_FIFO needs rtprio in limits.conf or CAP_SYS_NICE,
+// without it we carry on at normal priority.
+void AudioWorkerThread::setRealtime()
+{
+    struct sched_param param;
+    param.sched_priority = qMin(RT_PRIORITY, sched_get_priority_max(SCHED_FIFO));
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (err) qDebug() << "SCHED_FIFO not permitted:" << strerror(err);
+}
+
+void AudioWorkerThread::run()
+{
+    setRealtime();
+    running = true;
+
+    QVector<struct pollfd> fds;
+    for (Audio::Pcm *p : {&audio->receivePcm, &audio->transmitPcm, &audio->speakerPcm}) {
+        int count = snd_pcm_poll_descriptors_count(p->handle);
+        if (count <= 0) continue;
+        fds.resize(fds.size() + count);
+        snd_pcm_poll_descriptors(p->handle, fds.data() + fds.size() - count, count);
+    }
+
+    // Prime playback, each starts when its buffer is full
+    doSpeaker(audio->avail(audio->speakerPcm));
+    doTransmit(audio->avail(audio->transmitPcm));
+    int err = snd_pcm_start(audio->receivePcm.handle);
+    if (err < 0) qFatal("snd_pcm_start(receive)");
+
+    while (running) {
+        poll(fds.data(), fds.size(), POLL_MS);
+        doReceive();
+        doTransmit(audio->avail(audio->transmitPcm));
+        doSpeaker(audio->avail(audio->speakerPcm));
+    }
+
+    snd_pcm_drop(audio->speakerPcm.handle);
+    snd_pcm_drop(audio->receivePcm.handle);
+    snd_pcm_drop(audio->transmitPcm.handle);
+}
+
+void AudioWorkerThread::doSpeaker(snd_pcm_sframes_t frames)
+{
+    if (frames <= 0) return;
+    const float *rx = audio->speakerBlock(frames, Audio::BUFLEVEL_ALPHA);
+    while (frames > 0) {
+        snd_pcm_uframes_t chunk = frames;
+        void *buf = audio->transferBegin(audio->speakerPcm, chunk);
+        if (!buf || !chunk) return;
+        switch(audio->speakerFormat) {
+        case SPEAKER_INT16_MONO:
+            doSpeakerGeneric((AudioSpeakerInt16Mono*)buf, rx, chunk);
+            break;
+        case SPEAKER_INT16_STEREO:
+            doSpeakerGeneric((AudioSpeakerInt16Stereo*)buf, rx, chunk);
+            break;
+        case SPEAKER_FLOAT_MONO:
+            doSpeakerGeneric((AudioSpeakerFloatMono*)buf, rx, chunk);
+            break;
+        case SPEAKER_FLOAT_STEREO:
+            doSpeakerGeneric((AudioSpeakerFloatStereo*)buf, rx, chunk);
+            break;
+        }
+        if (!audio->transferEnd(audio->speakerPcm, chunk)) return;
+        rx += chunk;
+        frames -= chunk;
+    }
+}
+
+template <class T>
+void AudioWorkerThread::doSpeakerGeneric(T *buf, const float *rx, int frames)
+{
+    for (int i = 0; i < frames; i++) buf[i] = rx[i];
+}
+
+// Only what is available now, so a device that never
+// runs dry can't hold the loop.
+void AudioWorkerThread::doReceive()
+{
+    snd_pcm_sframes_t frames = audio->avail(audio->receivePcm);
+    while (frames > 0) {
+        snd_pcm_uframes_t chunk = frames;
+        qint16 *buf = (qint16*)audio->transferBegin(audio->receivePcm, chunk);
+        if (!buf || !chunk) return;
+        audio->receive(buf, chunk);
+        if (!audio->transferEnd(audio->receivePcm, chunk)) return;
+        frames -= chunk;
+    }
+}
+
+void AudioWorkerThread::doTransmit(snd_pcm_sframes_t frames)
+{
+    while (frames > 0) {
+        snd_pcm_uframes_t chunk = frames;
+        void *buf = audio->transferBegin(audio->transmitPcm, chunk);
+        if (!buf || !chunk) return;
+        audio->transmitBlock((std::complex<qint16>*)buf, chunk);
+        if (!audio->transferEnd(audio->transmitPcm, chunk)) return;
+        frames -= chunk;
+    }
+}
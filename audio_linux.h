@@ -0,0 +1,105 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AUDIO_LINUX_H
+#define AUDIO_LINUX_H
+
+#include "audio.h"
+#include <alsa/asoundlib.h>
+
+// ALSA devices default to the first card named Peaberry and the
+// "default" speaker. Both are saved in settings as alsaPeaberry and
+// alsaSpeaker so they can be pointed at other devices.
+
+class Audio : public AudioBase
+{
+    friend class AudioWorkerThread;
+    Q_OBJECT
+public:
+    explicit Audio(class Radio *radio = 0);
+    ~Audio();
+
+private:
+    static constexpr qreal BUFLEVEL_ALPHA = 0.0005;
+    // Period lengths and counts. Capture only adds one period
+    // of latency so it can afford a deep buffer.
+    static constexpr qreal RADIO_PERIOD = 0.002;
+    static constexpr qreal SPEAKER_PERIOD = 0.002;
+    static const int RECEIVE_PERIODS = 16;
+    static const int TRANSMIT_PERIODS = 3;
+    static const int SPEAKER_PERIODS = 4;
+
+    struct Pcm {
+        Pcm() : handle(NULL), capture(false), mmap(false),
+            periodFrames(0), bufferFrames(0), offset(0) {}
+        snd_pcm_t *handle;
+        bool capture;
+        bool mmap;
+        snd_pcm_uframes_t periodFrames;
+        snd_pcm_uframes_t bufferFrames;
+        snd_pcm_uframes_t offset;
+        QVector<char> scratch;
+    };
+
+    virtual int mutePaddingFrames();
+    virtual qreal transmitPaddingSecs();
+
+    QString findPeaberry();
+    void openPcm(Pcm &p, const QString &device, bool capture, bool isRadio,
+                 const QString &errstr);
+    snd_pcm_sframes_t avail(Pcm &p);
+    void *transferBegin(Pcm &p, snd_pcm_uframes_t &frames);
+    bool transferEnd(Pcm &p, snd_pcm_uframes_t frames);
+    void recover(Pcm &p, int err);
+
+public slots:
+    void start();
+    void stop();
+
+private:
+    Pcm speakerPcm;
+    quint8 speakerFormat;
+    Pcm receivePcm;
+    Pcm transmitPcm;
+
+    class AudioWorkerThread *worker;
+};
+
+
+class AudioWorkerThread : public QThread
+{
+    Q_OBJECT
+public:
+    AudioWorkerThread(Audio *audio) :
+        QThread(audio),
+        audio(audio) {}
+    ~AudioWorkerThread() {}
+    bool running;
+private:
+    // Longest wait when no device is ready
+    static const int POLL_MS = 5;
+    static const int RT_PRIORITY = 70;
+
+    Audio *audio;
+    void run();
+    void setRealtime();
+    void doSpeaker(snd_pcm_sframes_t frames);
+    template <class T> void doSpeakerGeneric(T *buf, const float *rx, int frames);
+    void doReceive();
+    void doTransmit(snd_pcm_sframes_t frames);
+};
+
+#endif // AUDIO_LINUX_H
@@ -49,6 +49,7 @@ Audio::Audio(Radio *radio) :
     configurePeabery(comp, peaberryID);
     if (!error.isEmpty()) return;
 
+    jitter.setRate(speakerSampleRate);
     speakerBufLevel = bufAverageTarget();
 }
 
@@ -85,6 +86,21 @@ void Audio::findDevices(AudioDeviceID &speakerID, AudioDeviceID &peaberryID)
         return;
     }
 
+    CFStringRef uid;
+    size = sizeof(CFStringRef);
+    propAddress = { kAudioDevicePropertyDeviceUID,
+                    kAudioObjectPropertyScopeGlobal,
+                    kAudioObjectPropertyElementMaster
+                  };
+    status = AudioObjectGetPropertyData(speakerID,
+                                        &propAddress,
+                                        0, NULL,
+                                        &size, &uid);
+    if (status == noErr) {
+        speakerKey = convCFStringToQString(uid);
+        CFRelease(uid);
+    }
+
     size = 0;
     propAddress = { kAudioHardwarePropertyDevices,
                     kAudioObjectPropertyScopeGlobal,
@@ -389,51 +405,9 @@ OSStatus Audio::speakerCallback(void *inRefCon,
     Q_UNUSED(inTimeStamp);
     Q_UNUSED(inBusNumber);
     Audio *audio = (Audio*)inRefCon;
-    int i = 0;
-    qreal volume = audio->speaker.volume;
-    int samps = audio->speaker.samples;
     Float32 *data = (Float32*)ioData->mBuffers[0].mData;
-    int freesamps = inNumberFrames;
-    if (samps > freesamps) samps = freesamps;
-
-    audio->updateBufAverageSize(freesamps, BUFLEVEL_ALPHA);
-
-    // Begin with window shape
-    while (audio->speaker.shapePos < audio->speaker.shape.size() && i < samps) {
-        audio->speaker.nco *= audio->speaker.clk;
-        data[i] = audio->speaker.shape[audio->speaker.shapePos] *
-                  audio->speaker.nco.real() *
-                  volume +
-                  audio->speakerBuffer[++audio->speakerBufferOut];
-        i++;
-        audio->speaker.shapePos++;
-    }
-    // Continuous tone
-    while (i < samps) {
-        audio->speaker.nco *= audio->speaker.clk;
-        data[i] = audio->speaker.nco.real() * volume + audio->speakerBuffer[++audio->speakerBufferOut];;
-        i++;
-    }
-    // Anything sent so far is considered for the timing.
-    audio->speaker.samples -= i;
-    if (audio->speaker.samples < 0) audio->speaker.samples = 0;
-    // End with window shape
-    if (!audio->speaker.samples) {
-        while (audio->speaker.shapePos && i < freesamps) {
-            audio->speaker.nco *= audio->speaker.clk;
-            audio->speaker.shapePos--;
-            data[i] = audio->speaker.shape[audio->speaker.shapePos] *
-                      audio->speaker.nco.real() *
-                      volume +
-                      audio->speakerBuffer[++audio->speakerBufferOut];;
-            i++;
-        }
-    }
-    // No tone
-    while (i < freesamps) {
-        data[i] = audio->speakerBuffer[++audio->speakerBufferOut];
-        i++;
-    }
+    const float *rx = audio->speakerBlock(inNumberFrames, BUFLEVEL_ALPHA);
+    std::copy(rx, rx + inNumberFrames, data);
     return noErr;
 }
 
@@ -449,47 +423,8 @@ OSStatus Audio::transmitCallback(void *inRefCon,
     Q_UNUSED(inTimeStamp);
     Q_UNUSED(inBusNumber);
     Audio *audio = (Audio*)inRefCon;
-    int i = 0;
-    qreal volume = audio->transmit.volume;
-    int samps = audio->transmit.samples;
     std::complex<Float32> *data = (std::complex<Float32>*)ioData->mBuffers[0].mData;
-    std::complex<Float32> tmp;
-    int freesamps = inNumberFrames;
-    if (samps > freesamps) samps = freesamps;
-
-    // Begin with window shape
-    while (audio->transmit.shapePos < audio->transmit.shape.size() && i < samps) {
-        audio->transmit.nco *= audio->transmit.clk;
-        tmp = audio->transmit.nco * (audio->transmit.shape[audio->transmit.shapePos] * volume);
-        data[i] = std::complex<Float32>(tmp.imag() * audio->txIqGain, tmp.real() + tmp.imag() * audio->txIqPhase);
-        i++;
-        audio->transmit.shapePos++;
-    }
-    // Continuous tone
-    while (i < samps) {
-        audio->transmit.nco *= audio->transmit.clk;
-        tmp = audio->transmit.nco * volume;
-        data[i] = std::complex<Float32>(tmp.imag() * audio->txIqGain, tmp.real() + tmp.imag() * audio->txIqPhase);
-        i++;
-    }
-    // Anything sent so far is considered for the timing.
-    audio->transmit.samples -= i;
-    if (audio->transmit.samples < 0) audio->transmit.samples = 0;
-    // End with window shape
-    if (!audio->transmit.samples) {
-        while (audio->transmit.shapePos && i < freesamps) {
-            audio->transmit.nco *= audio->transmit.clk;
-            audio->transmit.shapePos--;
-            tmp = audio->transmit.nco * (audio->transmit.shape[audio->transmit.shapePos] * volume);
-            data[i] = std::complex<Float32>(tmp.imag() * audio->txIqGain, tmp.real() + tmp.imag() * audio->txIqPhase);
-            i++;
-        }
-    }
-    // No tone
-    while (i < freesamps) {
-        data[i] = 0;
-        i++;
-    }
+    audio->transmitBlock(data, inNumberFrames);
     return noErr;
 }
 
@@ -516,34 +451,7 @@ OSStatus Audio::receiveCallback(void *inRefCon,
                           &audio->captureBufferList);
     if (err != noErr) return err;
 
-    int samples = inNumberFrames * 2, i = 0;
-    while (i < samples) {
-        if (audio->receiveMuteCount > 0) {
-            audio->receiveMuteCount--;
-            audio->receiveMuteVolume *= audio->receiveMuteRampDown;
-        } else {
-            audio->receiveMuteVolume = 1 - audio->receiveMuteRampUp +
-                                       audio->receiveMuteRampUp * audio->receiveMuteVolume;
-        }
-        REAL v2 = audio->captureBufData[i] * audio->receiveMuteVolume;
-        i++;
-        REAL v1 = audio->captureBufData[i] * audio->receiveMuteVolume;
-        i++;
-        quint16 pos = audio->capturePos++;
-        audio->captureRaw[pos] = COMPLEX(v1, v2);
-        v1 = v1 - audio->rxBiasReal;
-        v2 = v2 - audio->rxBiasImag;
-        v1 = v1 + v2 * audio->rxIqPhase;
-        v2 = v2 * audio->rxIqGain;
-        audio->captureAdj[pos] = COMPLEX(v1, v2);
-        if (!(++pos & (PEABERRYSIZE-1))) {
-            emit audio->demodUpdate(&audio->captureAdj[(quint16)(pos-PEABERRYSIZE)]);
-        }
-        if (++audio->captureCount >= PEABERRYRATE/SPECTRUM_FPS) {
-            emit audio->spectrumUpdate(audio->captureRaw.data(), audio->captureAdj.data(), audio->capturePos);
-            audio->captureCount = 0;
-        }
-    }
+    audio->receive(audio->captureBufData.constData(), inNumberFrames);
 
     return err;
 }
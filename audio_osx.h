@@ -28,7 +28,6 @@ class Audio : public AudioBase
 public:
     explicit Audio(class Radio *radio = 0);
     ~Audio();
-    QString error;
 
 private:
     static constexpr qreal OUTPUT_INTERVAL = 0.002;
@@ -164,6 +164,7 @@ Audio::Audio(Radio *radio) :
                    "sound playback device. You must select a different "
                    "device in Control Panel > Sound > Playback.");
     }
+    speakerKey = QString((QChar*)speakerID);
 
     hr = speakerDevice->Activate(
              IID_IAudioClient, CLSCTX_ALL,
@@ -594,52 +595,13 @@ void AudioWorkerThread::doSpeakerGeneric(int frames)
 {
     HRESULT hr;
     T *buf;
-    int i = 0, samps = audio->speaker.samples;
-    if (samps > frames) samps = frames;
 
-    audio->updateBufAverageSize(frames, Audio::BUFLEVEL_ALPHA);
+    const float *rx = audio->speakerBlock(frames, Audio::BUFLEVEL_ALPHA);
 
     hr = audio->speakerRenderClient->GetBuffer(frames, (BYTE**)&buf);
     if (FAILED(hr)) return;
 
-    // Begin with window shape
-    while (audio->speaker.shapePos < audio->speaker.shape.size() && i < samps) {
-        audio->speaker.nco *= audio->speaker.clk;
-        buf[i] = audio->speaker.shape[audio->speaker.shapePos]
-                 * audio->speaker.nco.real()
-                 * audio->speaker.volume
-                 + audio->speakerBuffer[++audio->speakerBufferOut];
-        i++;
-        audio->speaker.shapePos++;
-    }
-    // Continuous tone
-    while (i < samps) {
-        audio->speaker.nco *= audio->speaker.clk;
-        buf[i] = audio->speaker.nco.real()
-                 * audio->speaker.volume
-                 + audio->speakerBuffer[++audio->speakerBufferOut];
-        i++;
-    }
-    // Anything sent so far is considered for the timing.
-    audio->speaker.samples -= i;
-    if (audio->speaker.samples < 0) audio->speaker.samples = 0;
-    // End with window shape
-    if (!audio->speaker.samples) {
-        while (audio->speaker.shapePos && i < frames) {
-            audio->speaker.nco *= audio->speaker.clk;
-            audio->speaker.shapePos--;
-            buf[i] = audio->speaker.shape[audio->speaker.shapePos]
-                     * audio->speaker.nco.real()
-                     * audio->speaker.volume
-                     + audio->speakerBuffer[++audio->speakerBufferOut];
-            i++;
-        }
-    }
-    // Keep buffers full
-    while (i < frames) {
-        buf[i] = audio->speakerBuffer[++audio->speakerBufferOut];
-        i++;
-    }
+    for (int i = 0; i < frames; i++) buf[i] = rx[i];
     // Success
     hr = audio->speakerRenderClient->ReleaseBuffer(frames, 0);
 }
@@ -654,34 +616,7 @@ void AudioWorkerThread::doReceive()
     hr = audio->receiveCaptureClient->GetBuffer((BYTE**)&buf, &numFramesToRead, &dwFlags, NULL, NULL);
     if (!numFramesToRead || FAILED(hr)) return;
 
-    int samples = numFramesToRead * 2, i = 0;
-    while (i < samples) {
-        if (audio->receiveMuteCount > 0) {
-            audio->receiveMuteCount--;
-            audio->receiveMuteVolume *= audio->receiveMuteRampDown;
-        } else {
-            audio->receiveMuteVolume = 1 - audio->receiveMuteRampUp +
-                                       audio->receiveMuteRampUp * audio->receiveMuteVolume;
-        }
-        REAL v2 = buf[i] / 32767.0 * audio->receiveMuteVolume;
-        i++;
-        REAL v1 = buf[i] / 32767.0 * audio->receiveMuteVolume;
-        i++;
-        quint16 pos = audio->capturePos++;
-        audio->captureRaw[pos] = COMPLEX(v1,v2);
-        v1 = v1 - audio->rxBiasReal;
-        v2 = v2 - audio->rxBiasImag;
-        v1 = v1 + v2 * audio->rxIqPhase;
-        v2 = v2 * audio->rxIqGain;
-        audio->captureAdj[pos] = COMPLEX(v1,v2);
-        if (!(++pos & (PEABERRYSIZE-1))) {
-            emit audio->demodUpdate(&audio->captureAdj[(quint16)(pos-PEABERRYSIZE)]);
-        }
-        if (++audio->captureCount >= PEABERRYRATE/audio->SPECTRUM_FPS) {
-            emit audio->spectrumUpdate(audio->captureRaw.data(), audio->captureAdj.data(), audio->capturePos);
-            audio->captureCount = 0;
-        }
-    }
+    audio->receive(buf, numFramesToRead);
     audio->receiveCaptureClient->ReleaseBuffer(numFramesToRead);
     doReceive();
 }
@@ -691,46 +626,10 @@ void AudioWorkerThread::doTransmit(int frames)
     if (!frames) return;
     HRESULT hr;
     std::complex<INT16> *buf;
-    std::complex<qreal> tmp;
-    qreal volume = audio->transmit.volume * 32767;
-    int i = 0, samps = audio->transmit.samples;
-    if (samps > frames) samps = frames;
 
     hr = audio->transmitRenderClient->GetBuffer(frames, (BYTE**)&buf);
     if (FAILED(hr)) return;
 
-    // Begin with window shape
-    while (audio->transmit.shapePos < audio->transmit.shape.size() && i < samps) {
-        audio->transmit.nco *= audio->transmit.clk;
-        tmp = audio->transmit.nco * (audio->transmit.shape[audio->transmit.shapePos] * volume);
-        buf[i] = std::complex<INT16>(tmp.imag() * audio->txIqGain, tmp.real() + tmp.imag() * audio->txIqPhase);
-        i++;
-        audio->transmit.shapePos++;
-    }
-    // Continuous tone
-    while (i < samps) {
-        audio->transmit.nco *= audio->transmit.clk;
-        tmp = audio->transmit.nco * volume;
-        buf[i] = std::complex<INT16>(tmp.imag() * audio->txIqGain, tmp.real() + tmp.imag() * audio->txIqPhase);
-        i++;
-    }
-    // Anything sent so far is considered for the timing.
-    audio->transmit.samples -= i;
-    if (audio->transmit.samples < 0) audio->transmit.samples = 0;
-    // End with window shape
-    if (audio->transmit.samples == 0) {
-        while (audio->transmit.shapePos > 0 && i < frames) {
-            audio->transmit.nco *= audio->transmit.clk;
-            audio->transmit.shapePos--;
-            tmp = audio->transmit.nco * (audio->transmit.shape[audio->transmit.shapePos] * volume);
-            buf[i] = std::complex<INT16>(tmp.imag() * audio->txIqGain, tmp.real() + tmp.imag() * audio->txIqPhase);
-            i++;
-        }
-    }
-    // No tone
-    while (i < frames) {
-        buf[i] = 0;
-        i++;
-    }
+    audio->transmitBlock(buf, frames);
     hr = audio->transmitRenderClient->ReleaseBuffer(frames, 0);
 }
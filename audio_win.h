@@ -34,7 +34,6 @@ class Audio : public AudioBase
 public:
     explicit Audio(class Radio *radio = 0);
     ~Audio();
-    QString error;
 
 private:
     static constexpr qreal BUFLEVEL_ALPHA = 0.0005;
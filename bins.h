@@ -0,0 +1,245 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BINS_H
+#define BINS_H
+
+#include "dsp.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Bulk operations on arrays of spectrum bins.
+// These run on every visible bin of every frame so they
+// avoid transcendental functions and use SSE2 when available.
+// The *Reference versions are the plain math that
+// --benchmark-bins checks them against.
+
+namespace Bins {
+
+// Smallest power we will convert, -300 dB.
+static const REAL POWER_MIN = 1e-30f;
+
+// 10*log10(2)
+static const REAL DB_PER_OCTAVE = 3.0102999566f;
+
+// Mantissa polynomial for log2 on [1,2), error about 1e-4 (0.0004 dB).
+static const REAL LOG2_C1 = 1.4386380259f;
+static const REAL LOG2_C2 = -0.6777432666f;
+static const REAL LOG2_C3 = 0.3218797069f;
+static const REAL LOG2_C4 = -0.0828606983f;
+
+/// Fast log2 from the float exponent bits and a polynomial.
+inline REAL fastLog2(REAL x) {
+    int32_t i;
+    std::memcpy(&i, &x, sizeof(i));
+    REAL e = (REAL)((i >> 23) - 127);
+    i = (i & 0x007FFFFF) | 0x3F800000;
+    REAL t;
+    std::memcpy(&t, &i, sizeof(t));
+    t -= 1;
+    return e + t * (LOG2_C1 + t * (LOG2_C2 + t * (LOG2_C3 + t * LOG2_C4)));
+}
+
+/// out[i] = |in[i]|^2 * scale
+inline void power(const COMPLEX *in, REAL *out, int n, REAL scale) {
+    const REAL *f = reinterpret_cast<const REAL*>(in);
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 s = _mm_set1_ps(scale);
+    for (; i + 4 <= n; i += 4) {
+        __m128 a = _mm_loadu_ps(f + i * 2);
+        __m128 b = _mm_loadu_ps(f + i * 2 + 4);
+        a = _mm_mul_ps(a, a);
+        b = _mm_mul_ps(b, b);
+        __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(re, im), s));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = (f[i*2] * f[i*2] + f[i*2+1] * f[i*2+1]) * scale;
+    }
+}
+
+/// avg[i] += alpha * (in[i] - avg[i])
+inline void smooth(REAL *avg, const REAL *in, int n, REAL alpha) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 a = _mm_set1_ps(alpha);
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(avg + i);
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(in + i), v);
+        _mm_storeu_ps(avg + i, _mm_add_ps(v, _mm_mul_ps(d, a)));
+    }
+#endif
+    for (; i < n; ++i) {
+        avg[i] += alpha * (in[i] - avg[i]);
+    }
+}
+
+/// out[i] = in[i] + offset
+inline void add(const REAL *in, REAL *out, int n, REAL offset) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 off = _mm_set1_ps(offset);
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(in + i), off));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = in[i] + offset;
+    }
+}
+
+/// hold[i] = max(in[i], hold[i] - decay)
+inline void peakHold(REAL *hold, const REAL *in, int n, REAL decay) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 d = _mm_set1_ps(decay);
+    for (; i + 4 <= n; i += 4) {
+        __m128 h = _mm_sub_ps(_mm_loadu_ps(hold + i), d);
+        _mm_storeu_ps(hold + i, _mm_max_ps(_mm_loadu_ps(in + i), h));
+    }
+#endif
+    for (; i < n; ++i) {
+        hold[i] = std::max(in[i], hold[i] - decay);
+    }
+}
+
+/// hold[i] = min(in[i], hold[i] + rise)
+inline void minHold(REAL *hold, const REAL *in, int n, REAL rise) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 r = _mm_set1_ps(rise);
+    for (; i + 4 <= n; i += 4) {
+        __m128 h = _mm_add_ps(_mm_loadu_ps(hold + i), r);
+        _mm_storeu_ps(hold + i, _mm_min_ps(_mm_loadu_ps(in + i), h));
+    }
+#endif
+    for (; i < n; ++i) {
+        hold[i] = std::min(in[i], hold[i] + rise);
+    }
+}
+
+/// Reduce n bins to m points keeping the largest of each group.
+/// Copies when m >= n.
+inline void reduceMax(const REAL *in, int n, REAL *out, int m) {
+    if (m >= n) {
+        std::copy(in, in + n, out);
+        return;
+    }
+    for (int p = 0; p < m; ++p) {
+        int first = (int)((int64_t)p * n / m);
+        int last = (int)((int64_t)(p + 1) * n / m);
+        out[p] = *std::max_element(in + first, in + last);
+    }
+}
+
+/// Reduce n bins to m points averaging each group.
+/// Copies when m >= n.
+inline void reduceMean(const REAL *in, int n, REAL *out, int m) {
+    if (m >= n) {
+        std::copy(in, in + n, out);
+        return;
+    }
+    for (int p = 0; p < m; ++p) {
+        int first = (int)((int64_t)p * n / m);
+        int last = (int)((int64_t)(p + 1) * n / m);
+        REAL sum = 0;
+        for (int i = first; i < last; ++i) sum += in[i];
+        out[p] = sum / (last - first);
+    }
+}
+
+/// Decay a histogram of levels rows by points columns and add
+/// hit to every row from lo[x] to hi[x] of each column.
+/// hist = min(65535, hist * keep / 65536 + hit), out = hist / 256
+inline void persist(uint16_t *hist, uint8_t *out, const int16_t *lo, const int16_t *hi,
+                    int points, int levels, uint16_t keep, uint16_t hit) {
+    for (int level = 0; level < levels; ++level) {
+        uint16_t *h = hist + level * points;
+        uint8_t *o = out + level * points;
+        int x = 0;
+#ifdef __SSE2__
+        const __m128i k = _mm_set1_epi16((short)keep);
+        const __m128i add = _mm_set1_epi16((short)hit);
+        const __m128i l = _mm_set1_epi16((short)level);
+        for (; x + 8 <= points; x += 8) {
+            __m128i outside = _mm_or_si128(
+                _mm_cmpgt_epi16(_mm_loadu_si128((const __m128i*)(lo + x)), l),
+                _mm_cmpgt_epi16(l, _mm_loadu_si128((const __m128i*)(hi + x))));
+            __m128i v = _mm_mulhi_epu16(_mm_loadu_si128((const __m128i*)(h + x)), k);
+            v = _mm_adds_epu16(v, _mm_andnot_si128(outside, add));
+            _mm_storeu_si128((__m128i*)(h + x), v);
+            v = _mm_srli_epi16(v, 8);
+            _mm_storel_epi64((__m128i*)(o + x), _mm_packus_epi16(v, v));
+        }
+#endif
+        for (; x < points; ++x) {
+            uint32_t v = ((uint32_t)h[x] * keep) >> 16;
+            if (lo[x] <= level && level <= hi[x]) v = std::min<uint32_t>(65535, v + hit);
+            h[x] = v;
+            o[x] = v >> 8;
+        }
+    }
+}
+
+/// out[i] = 10*log10(in[i]) + offset
+inline void powerToDb(const REAL *in, REAL *out, int n, REAL offset) {
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 pmin = _mm_set1_ps(POWER_MIN);
+    const __m128i mantMask = _mm_set1_epi32(0x007FFFFF);
+    const __m128i oneBits = _mm_set1_epi32(0x3F800000);
+    const __m128i bias = _mm_set1_epi32(127);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 c1 = _mm_set1_ps(LOG2_C1);
+    const __m128 c2 = _mm_set1_ps(LOG2_C2);
+    const __m128 c3 = _mm_set1_ps(LOG2_C3);
+    const __m128 c4 = _mm_set1_ps(LOG2_C4);
+    const __m128 scale = _mm_set1_ps(DB_PER_OCTAVE);
+    const __m128 off = _mm_set1_ps(offset);
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_castps_si128(_mm_max_ps(_mm_loadu_ps(in + i), pmin));
+        __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(x, 23), bias));
+        __m128 t = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(x, mantMask), oneBits));
+        t = _mm_sub_ps(t, one);
+        __m128 p = _mm_add_ps(c3, _mm_mul_ps(t, c4));
+        p = _mm_add_ps(c2, _mm_mul_ps(t, p));
+        p = _mm_add_ps(c1, _mm_mul_ps(t, p));
+        p = _mm_add_ps(e, _mm_mul_ps(t, p));
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(p, scale), off));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = fastLog2(std::max(in[i], POWER_MIN)) * DB_PER_OCTAVE + offset;
+    }
+}
+
+/// Reference for powerToDb.
+inline void powerToDbReference(const REAL *in, REAL *out, int n, REAL offset) {
+    for (int i = 0; i < n; ++i) {
+        out[i] = 10 * log10(std::max(in[i], POWER_MIN)) + offset;
+    }
+}
+
+} // namespace Bins
+
+#endif // BINS_H
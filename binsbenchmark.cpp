@@ -0,0 +1,64 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "binsbenchmark.h"
+#include "bins.h"
+#include <random>
+
+int BinsBenchmark::run()
+{
+    QTextStream out(stdout);
+
+    // Every power level in the sweep with a random mantissa wobble
+    // so the polynomial sees its whole range at each exponent.
+    std::minstd_rand rng(1);
+    std::uniform_real_distribution<double> wobble(0, 1.0 / SWEEP_STEPS_PER_DB);
+    QVector<REAL> in;
+    for (int i = SWEEP_MIN_DB * SWEEP_STEPS_PER_DB; i < SWEEP_MAX_DB * SWEEP_STEPS_PER_DB; ++i) {
+        in.append(pow(10, ((double)i / SWEEP_STEPS_PER_DB + wobble(rng)) / 10));
+    }
+    in.append(0);
+    const int n = in.size();
+    QVector<REAL> fast(n), ref(n);
+    Bins::powerToDb(in.constData(), fast.data(), n, 0);
+    Bins::powerToDbReference(in.constData(), ref.data(), n, 0);
+    qreal worst = 0;
+    REAL worstIn = 0;
+    for (int i = 0; i < n; ++i) {
+        qreal err = std::abs(fast[i] - ref[i]);
+        if (err > worst) {
+            worst = err;
+            worstIn = in[i];
+        }
+    }
+
+    QVector<REAL> view(BINS), db(BINS);
+    for (int i = 0; i < BINS; ++i) view[i] = in[i * n / BINS];
+    QElapsedTimer timer;
+    timer.start();
+    for (int pass = 0; pass < PASSES; ++pass) Bins::powerToDb(view.constData(), db.data(), BINS, 0);
+    qint64 fastNs = timer.nsecsElapsed();
+    timer.restart();
+    for (int pass = 0; pass < PASSES; ++pass) Bins::powerToDbReference(view.constData(), db.data(), BINS, 0);
+    qint64 refNs = timer.nsecsElapsed();
+
+    bool ok = worst <= POWER_TO_DB_TOLERANCE;
+    out << "powerToDb " << n << " inputs, max error " << worst << " dB at " << worstIn
+        << (ok ? "" : " FAIL") << endl;
+    out << "powerToDb " << BINS << " bins " << fastNs / PASSES / 1000.0 << " us, reference "
+        << refNs / PASSES / 1000.0 << " us" << endl;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
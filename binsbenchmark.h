@@ -0,0 +1,43 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BINSBENCHMARK_H
+#define BINSBENCHMARK_H
+
+#include <QtCore>
+
+// Checks the fast Bins kernels against their *Reference versions
+// over a sweep of inputs and prints the worst error and the time
+// for a full view of bins. Run with --benchmark-bins, it fails
+// when a kernel is off by more than its tolerance.
+
+class BinsBenchmark
+{
+public:
+    static int run();
+
+private:
+    // One full view of bins per pass
+    static const int BINS = 8192;
+    static const int PASSES = 1000;
+    // Sweep from below POWER_MIN to far above full scale
+    static const int SWEEP_MIN_DB = -320;
+    static const int SWEEP_MAX_DB = 60;
+    static const int SWEEP_STEPS_PER_DB = 100;
+    static constexpr qreal POWER_TO_DB_TOLERANCE = 0.01;
+};
+
+#endif // BINSBENCHMARK_H
@@ -0,0 +1,107 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BLOCKQUEUE_H
+#define BLOCKQUEUE_H
+
+#include <QtCore>
+
+// Bounded lock-free queue of fixed-size blocks from one writer thread
+// to one reader thread. The blocks are allocated once. The writer
+// fills next() and push() stamps it with a sequence number and the
+// caller's time and publishes it with release. The reader takes
+// front() after an acquire and pop() hands the slot back. A full
+// queue drops the new block and counts an overrun, which the reader
+// sees as a gap in the sequence numbers.
+//
+// push() returns true when the reader needs waking. The reader calls
+// rearm() before it drains the queue, so one wakeup covers every
+// block pushed until then.
+
+template<typename T>
+class BlockQueue
+{
+public:
+    BlockQueue(int count, int blockSize) :
+        blocks(count * blockSize),
+        sequences(count),
+        stamps(count),
+        mask(count - 1),
+        blockSize(blockSize),
+        m_sequence(0),
+        m_head(0),
+        m_tail(0),
+        m_waiting(0),
+        m_overruns(0)
+    {
+        Q_ASSERT(count > 0 && !(count & mask));
+    }
+
+    // Writer side, NULL when full
+    T *next() {
+        quint32 head = m_head.load();
+        if (head - m_tail.loadAcquire() > mask) {
+            m_sequence++;
+            m_overruns.fetchAndAddRelaxed(1);
+            return NULL;
+        }
+        return blocks.data() + (head & mask) * blockSize;
+    }
+    bool push(qint64 stamp) {
+        quint32 head = m_head.load();
+        sequences[head & mask] = m_sequence++;
+        stamps[head & mask] = stamp;
+        m_head.storeRelease(head + 1);
+        return !m_waiting.fetchAndStoreOrdered(1);
+    }
+
+    // Reader side, NULL when empty
+    const T *front(quint32 &sequence, qint64 &stamp) const {
+        quint32 tail = m_tail.load();
+        if (m_head.loadAcquire() == tail) return NULL;
+        sequence = sequences[tail & mask];
+        stamp = stamps[tail & mask];
+        return blocks.constData() + (tail & mask) * blockSize;
+    }
+    void pop() {
+        m_tail.storeRelease(m_tail.load() + 1);
+    }
+    void rearm() {
+        m_waiting.fetchAndStoreOrdered(0);
+    }
+
+    // Instrumentation, safe from any thread
+    inline int fill() const {
+        return (int)(m_head.loadAcquire() - m_tail.loadAcquire());
+    }
+    inline quint32 overruns() const {
+        return m_overruns.load();
+    }
+
+private:
+    QVector<T> blocks;
+    QVector<quint32> sequences;
+    QVector<qint64> stamps;
+    const quint32 mask;
+    const int blockSize;
+    quint32 m_sequence;
+    QAtomicInteger<quint32> m_head;
+    QAtomicInteger<quint32> m_tail;
+    QAtomicInt m_waiting;
+    QAtomicInteger<quint32> m_overruns;
+};
+
+#endif // BLOCKQUEUE_H
@@ -0,0 +1,118 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include "dsp.h"
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Conversion of interleaved receive audio into captureRaw and
+// captureAdj, shared by all the audio backends. The radio sends the
+// imaginary channel first. Uses SSE2 when available, the scalar
+// loops do the same float math in the same order.
+
+namespace Capture {
+
+// Applied after the mute gain
+struct Correction {
+    REAL biasRe;
+    REAL biasIm;
+    REAL phase;
+    REAL gain;
+};
+
+#ifdef __SSE2__
+// x is two frames as received, mute is their gains as m0,m0,m1,m1
+inline void convert2(__m128 x, __m128 mute, __m128 scale, __m128 bias,
+                     __m128 direct, __m128 cross, float *raw, float *adj) {
+    x = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1));
+    x = _mm_mul_ps(_mm_mul_ps(x, scale), mute);
+    _mm_storeu_ps(raw, x);
+    __m128 d = _mm_sub_ps(x, bias);
+    __m128 s = _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1));
+    _mm_storeu_ps(adj, _mm_add_ps(_mm_mul_ps(d, direct), _mm_mul_ps(s, cross)));
+}
+
+// Gains for frames i and i+1, or unity
+inline __m128 mute2(const REAL *mute, int i) {
+    if (!mute) return _mm_set1_ps(1);
+    __m128 m = _mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(mute + i)));
+    return _mm_unpacklo_ps(m, m);
+}
+#endif
+
+inline void convert1(REAL c0, REAL c1, REAL scale, REAL mute, const Correction &c,
+                     COMPLEX *raw, COMPLEX *adj) {
+    REAL re = c1 * scale * mute;
+    REAL im = c0 * scale * mute;
+    *raw = COMPLEX(re, im);
+    re = re - c.biasRe;
+    im = im - c.biasIm;
+    *adj = COMPLEX(re + im * c.phase, im * c.gain);
+}
+
+/// raw = in * scale * mute, adj = corrected raw
+/// mute holds one gain per frame, or is null for unity.
+inline void convert(const int16_t *in, COMPLEX *raw, COMPLEX *adj, int frames,
+                    REAL scale, const REAL *mute, const Correction &c) {
+    int i = 0;
+#ifdef __SSE2__
+    float *r = reinterpret_cast<float*>(raw);
+    float *a = reinterpret_cast<float*>(adj);
+    const __m128 s = _mm_set1_ps(scale);
+    const __m128 bias = _mm_setr_ps(c.biasRe, c.biasIm, c.biasRe, c.biasIm);
+    const __m128 direct = _mm_setr_ps(1, c.gain, 1, c.gain);
+    const __m128 cross = _mm_setr_ps(c.phase, 0, c.phase, 0);
+    for (; i + 4 <= frames; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i * 2));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+        convert2(lo, mute2(mute, i), s, bias, direct, cross, r + i * 2, a + i * 2);
+        convert2(hi, mute2(mute, i + 2), s, bias, direct, cross, r + i * 2 + 4, a + i * 2 + 4);
+    }
+#endif
+    for (; i < frames; ++i) {
+        convert1(in[i*2], in[i*2+1], scale, mute ? mute[i] : 1, c, raw + i, adj + i);
+    }
+}
+
+inline void convert(const float *in, COMPLEX *raw, COMPLEX *adj, int frames,
+                    REAL scale, const REAL *mute, const Correction &c) {
+    int i = 0;
+#ifdef __SSE2__
+    float *r = reinterpret_cast<float*>(raw);
+    float *a = reinterpret_cast<float*>(adj);
+    const __m128 s = _mm_set1_ps(scale);
+    const __m128 bias = _mm_setr_ps(c.biasRe, c.biasIm, c.biasRe, c.biasIm);
+    const __m128 direct = _mm_setr_ps(1, c.gain, 1, c.gain);
+    const __m128 cross = _mm_setr_ps(c.phase, 0, c.phase, 0);
+    for (; i + 2 <= frames; i += 2) {
+        convert2(_mm_loadu_ps(in + i * 2), mute2(mute, i), s, bias, direct, cross,
+                 r + i * 2, a + i * 2);
+    }
+#endif
+    for (; i < frames; ++i) {
+        convert1(in[i*2], in[i*2+1], scale, mute ? mute[i] : 1, c, raw + i, adj + i);
+    }
+}
+
+} // namespace Capture
+
+#endif // CAPTURE_H
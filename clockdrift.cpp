@@ -0,0 +1,87 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "clockdrift.h"
+
+constexpr qreal ClockDrift::MAX_PPM;
+constexpr qreal ClockDrift::MAX_CORRECTION;
+
+ClockDrift::ClockDrift()
+{
+    seedValue = 0;
+    seedVariance = MAX_PPM * MAX_PPM * 1e-12;
+    estimate = 0;
+    level = 0;
+    restart();
+}
+
+void ClockDrift::restart()
+{
+    m_locked = false;
+    elapsed = 0;
+    s0 = st = stt = sy = sty = syy = 0;
+}
+
+void ClockDrift::seed(qreal ppm)
+{
+    if (m_locked) return;
+    seedValue = estimate = qBound(-MAX_PPM, ppm, MAX_PPM) * 1e-6;
+    seedVariance = SEED_PPM * SEED_PPM * 1e-12;
+}
+
+qreal ClockDrift::update(qreal phaseSecs, qreal levelErrorSecs, qreal blockSecs)
+{
+    level += (levelErrorSecs - level) * std::min(1.0, blockSecs / LEVEL_SECS);
+    elapsed += blockSecs;
+
+    if (elapsed > SETTLE_SECS) {
+        if (s0 > 0 && elapsed > SETTLE_SECS + MIN_WINDOW_SECS) {
+            qreal predicted = sy / s0 + estimate * (blockSecs - st / s0);
+            if (std::abs(phaseSecs - predicted) > OUTLIER_SECS) {
+                #ifdef QT_DEBUG
+                qWarning() << "CLOCK DRIFT restart at" << ppm() << "ppm";
+                #endif
+                restart();
+                seed(estimate * 1e6);
+            }
+        }
+        // Age the sums and move time zero to this block
+        qreal decay = elapsed - SETTLE_SECS < MAX_WINDOW_SECS ? 1 : exp(-blockSecs / MAX_WINDOW_SECS);
+        s0 *= decay; st *= decay; stt *= decay;
+        sy *= decay; sty *= decay; syy *= decay;
+        stt += -2 * blockSecs * st + blockSecs * blockSecs * s0;
+        st -= blockSecs * s0;
+        sty -= blockSecs * sy;
+        s0 += 1;
+        sy += phaseSecs;
+        syy += phaseSecs * phaseSecs;
+    }
+
+    qreal sxx = stt - st * st / s0;
+    if (s0 > 2 && sxx > 0 && elapsed > SETTLE_SECS + MIN_WINDOW_SECS) {
+        qreal sxy = sty - st * sy / s0;
+        qreal slope = sxy / sxx;
+        qreal residual = std::max(0.0, syy - sy * sy / s0 - slope * sxy) / (s0 - 2);
+        qreal variance = residual / sxx;
+        // Inverse variance blend with the seed
+        estimate = (slope * seedVariance + seedValue * variance) / (seedVariance + variance);
+        estimate = qBound(-MAX_PPM * 1e-6, estimate, MAX_PPM * 1e-6);
+        variance = variance * seedVariance / (variance + seedVariance);
+        m_locked = variance < LOCK_PPM * LOCK_PPM * 1e-12;
+    }
+
+    return qBound(-MAX_CORRECTION, estimate + level / PULL_SECS, MAX_CORRECTION);
+}
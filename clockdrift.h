@@ -0,0 +1,79 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CLOCKDRIFT_H
+#define CLOCKDRIFT_H
+
+#include <QtCore>
+
+// Measures how far the speaker clock runs from the Peaberry clock
+// and steers the resampler with it. The drift phase is what demod
+// would have delivered without any rate correction less what the
+// speaker had asked for when each capture block arrived, both from
+// timestamps rather than the raw counts. Blocks come from the
+// Peaberry clock, so the slope of that phase against block time is
+// the drift, untouched by corrections, skips or underruns.
+//
+// The slope is a least squares fit over everything since the last
+// restart until that spans MAX_WINDOW_SECS, then ages out over that,
+// so a cold start has an estimate in a few seconds. A saved
+// estimate is blended in by its assumed error until the fit beats it.
+// The correction is the drift plus a proportional pull of the buffer
+// level onto its target.
+
+class ClockDrift
+{
+public:
+    ClockDrift();
+    void restart();
+    // Starting estimate, positive when the speaker is slow
+    void seed(qreal ppm);
+    // Both in seconds. Returns the fraction to speed up the resampler.
+    qreal update(qreal phaseSecs, qreal levelErrorSecs, qreal blockSecs);
+
+    inline qreal ppm() const {
+        return estimate * 1e6;
+    }
+    // Fit error is under LOCK_PPM
+    inline bool locked() const {
+        return m_locked;
+    }
+
+private:
+    static constexpr qreal SETTLE_SECS = 1.0;
+    static constexpr qreal MIN_WINDOW_SECS = 2.0;
+    static constexpr qreal MAX_WINDOW_SECS = 60.0;
+    // A phase this far off the fit is a stall, start over
+    static constexpr qreal OUTLIER_SECS = 0.050;
+    static constexpr qreal SEED_PPM = 5.0;
+    static constexpr qreal LOCK_PPM = 10.0;
+    static constexpr qreal MAX_PPM = 1000.0;
+    // Level error is smoothed then pulled out over PULL_SECS
+    static constexpr qreal LEVEL_SECS = 1.0;
+    static constexpr qreal PULL_SECS = 10.0;
+    static constexpr qreal MAX_CORRECTION = 0.01;
+
+    qreal seedValue;
+    qreal seedVariance;
+    qreal estimate;
+    bool m_locked;
+    qreal level;
+    qreal elapsed;
+    // Exponentially weighted sums, time is relative to the newest point
+    qreal s0, st, stt, sy, sty, syy;
+};
+
+#endif // CLOCKDRIFT_H
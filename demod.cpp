@@ -20,11 +20,12 @@
 #include "agc.h"
 #include "fft.h"
 
-Demod::Demod(Radio *radio, class Audio *audio) :
+Demod::Demod(Radio *radio, AudioBase *audio) :
     radio(radio),
     audio(audio),
     ovsvFilter(DEMODSIZE*2),
     ovsvWork(DEMODSIZE*2),
+    resampleOut(DEMODSIZE),
     tempData(DEMODSIZE*2)
 {
     agc = new Agc(radio);
@@ -44,10 +45,30 @@ Demod::Demod(Radio *radio, class Audio *audio) :
 
     setupResampler();
 
+    // Ballistics are applied once per block
+    const qreal blockSecs = (qreal)DEMODSIZE / DEMODRATE;
+    smeterAttack = 1.0 - exp(-blockSecs / SMETER_ATTACK);
+    smeterDecay = 1.0 - exp(-blockSecs / SMETER_DECAY);
+    smeterBlocks = std::max(1, qRound(SMETER_INTERVAL / blockSecs));
+    smeterLevel = 0;
+    smeterCount = 0;
+    driftReportBlocks = qRound(DRIFT_REPORT_SECS / blockSecs);
+    driftReportCount = 0;
+    dbOffset = 0;
+    nextSequence = 0;
+    blocksLost = 0;
+    blockNs = 0;
+    blockSteps = 1;
+
+    connect(this, SIGNAL(smeterUpdate(qreal)), radio, SIGNAL(smeterUpdate(qreal)));
+    connect(this, SIGNAL(clockDriftUpdate(qreal)), radio, SLOT(setClockDrift(qreal)));
+    connect(radio, SIGNAL(clockDriftChanged(qreal)), this, SLOT(setClockDrift(qreal)));
+
     connect(radio, SIGNAL(gainChanged(int)), this, SLOT(setGain(int)));
     connect(radio, SIGNAL(filterChanged(int)), this, SLOT(setFilter(int)));
     connect(radio, SIGNAL(cwrChanged(bool)), this, SLOT(setCwr(bool)));
     connect(radio, SIGNAL(rxToneChanged(int)), this, SLOT(setTone(int)));
+    connect(radio, SIGNAL(dbOffsetChanged(qreal)), this, SLOT(setDbOffset(qreal)));
 }
 
 Demod::~Demod()
@@ -79,17 +100,49 @@ void Demod::setCwr(bool r)
     configureFirOvSvMixer();
 }
 
-void Demod::demod(COMPLEX *data)
+void Demod::setDbOffset(qreal db)
+{
+    dbOffset = db;
+}
+
+// Saved estimate for this speaker, only used until locked
+void Demod::setClockDrift(qreal ppm)
+{
+    drift.seed(ppm);
+}
+
+// Takes every block queued by the audio thread. Missing
+// sequence numbers are blocks dropped while we were behind.
+void Demod::demodQueued()
+{
+    audio->demodQueue.rearm();
+    quint32 sequence;
+    while (const COMPLEX *block = audio->demodQueue.front(sequence, blockNs)) {
+        if (sequence != nextSequence) {
+            blocksLost += sequence - nextSequence;
+            #ifdef QT_DEBUG
+            qWarning() << "DEMOD OVERRUN blocksLost =" << blocksLost;
+            #endif
+        }
+        blockSteps = sequence - nextSequence + 1;
+        nextSequence = sequence + 1;
+        demod(block);
+        audio->demodQueue.pop();
+    }
+}
+
+void Demod::demod(const COMPLEX *data)
 {
     // cpxData is double sized. Used the second half for work.
     // First half is used for resampler to keep an overlap.
     mixAndDecimate(data, &tempData[DEMODSIZE]);
     firOvSv(&tempData[DEMODSIZE], &tempData[DEMODSIZE]);
+    smeter(&tempData[DEMODSIZE]);
     agc->Process(&tempData[DEMODSIZE]);
     resample(&tempData[DEMODSIZE-RESAMPLE_SINC_SIZE]);
 }
 
-void Demod::mixAndDecimate(COMPLEX *inData, COMPLEX *outData)
+void Demod::mixAndDecimate(const COMPLEX *inData, COMPLEX *outData)
 {
     // 11-tap LPF designed by Moe Wheatley AE4JY
     static const REAL FIR0 = 0.0060431029837374152;
@@ -179,6 +232,23 @@ void Demod::firOvSv(COMPLEX *inData, COMPLEX *outData)
     }
 }
 
+// Power in the filter passband before AGC.
+// Full scale sine wave is 0 dB, same as the spectrum.
+void Demod::smeter(COMPLEX *data)
+{
+    REAL power = 0;
+    for (int i = 0; i < DEMODSIZE; i++) power += std::norm(data[i]);
+    power /= DEMODSIZE;
+
+    if (power > smeterLevel) smeterLevel += smeterAttack * (power - smeterLevel);
+    else smeterLevel += smeterDecay * (power - smeterLevel);
+
+    if (++smeterCount >= smeterBlocks) {
+        smeterCount = 0;
+        emit smeterUpdate(10 * log10(smeterLevel + 1e-20) + dbOffset);
+    }
+}
+
 void Demod::setupResampler()
 {
     const int size = RESAMPLE_SINC_SIZE * RESAMPLE_POSITIONS;
@@ -199,11 +269,14 @@ void Demod::setupResampler()
     }
     resamplePos = 0;
     resampleRate = (qreal)DEMODRATE / audio->bufSampleRate();
+    driftRate = 0;
+    driftProduced = driftStart = 0;
 }
 
 void Demod::resample(COMPLEX *inData)
 {
     int tablePos, inPos = resamplePos;
+    int outCount = 0, written = 0;
     while (inPos < DEMODSIZE) {
         // Find the proper sinc filter for our position in time
         if (inPos == resamplePos) tablePos = 0;
@@ -214,26 +287,55 @@ void Demod::resample(COMPLEX *inData)
         for (int i=0; i < RESAMPLE_SINC_SIZE; i++) {
             sample += (inData[inPos+i].real() * resampleTable[tablePos+i] );
         }
-        // Store result in the audio output circular buffer
-        audio->bufAppend(sample * gain);
+        // Collected for the audio output ring
+        resampleOut[outCount++] = sample * gain;
+        if (outCount == resampleOut.size()) {
+            audio->bufWrite(resampleOut.constData(), outCount);
+            written += outCount;
+            outCount = 0;
+        }
         resamplePos += resampleRate;
         inPos = resamplePos;
     }
+    audio->bufWrite(resampleOut.constData(), outCount);
+    written += outCount;
     resamplePos -= DEMODSIZE;
 
     // Preserve overlap for next pass
     for (int i = 0; i < RESAMPLE_SINC_SIZE; i++) {
         inData[i] = inData[i+DEMODSIZE];
     }
-    // recompute the rate correction
-    qreal rateGain = 5e-7 * (audio->bufSampleRate() / (qreal)DEMODRATE);
-    resampleRate = (qreal)DEMODRATE / audio->bufSampleRate() *
-                   (1 + rateGain * (audio->bufAverageSize() -  audio->bufAverageTarget()));
-
-    // Debug helper for tuning constants
-    //static int debugCount = 0;
-    //if (!debugCount--) {
-    //    debugCount = 20;
-    //    qDebug() << audio->bufAverageSize() << audio->bufAverageTarget() << resampleRate;
-    //}
+    updateRate(written);
+}
+
+// The drift phase counts what the blocks since the restart would have
+// written without correction, dropped ones included, against what the
+// speaker had asked for when this block was captured. The level is
+// taken halfway through what was just written to match the average
+// the speaker side aims at.
+void Demod::updateRate(int written)
+{
+    const qreal rate = audio->bufSampleRate();
+    const qreal consumed = audio->bufFramesAt(blockNs);
+    if (rate != driftRate) {
+        driftRate = rate;
+        driftProduced = 0;
+        driftStart = consumed;
+        drift.restart();
+    }
+    driftProduced += blockSteps * DEMODSIZE * rate / DEMODRATE;
+
+    qreal level = audio->bufRing().fill() - written / 2.0 - audio->bufAverageTarget();
+    bool wasLocked = drift.locked();
+    qreal correction = drift.update((driftProduced - consumed + driftStart) / rate, level / rate,
+                                    blockSteps * (qreal)DEMODSIZE / DEMODRATE);
+    resampleRate = (qreal)DEMODRATE / rate * (1 + correction);
+
+    if (drift.locked() && (!wasLocked || ++driftReportCount >= driftReportBlocks)) {
+        #ifdef QT_DEBUG
+        if (!wasLocked) qDebug() << "clock drift locked at" << drift.ppm() << "ppm";
+        #endif
+        driftReportCount = 0;
+        emit clockDriftUpdate(drift.ppm());
+    }
 }
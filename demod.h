@@ -19,17 +19,18 @@
 
 #include <QtCore>
 #include "dsp.h"
+#include "clockdrift.h"
 
 class Demod : public QObject
 {
     Q_OBJECT
 public:
-    explicit Demod(class Radio *radio, class Audio *audio);
+    explicit Demod(class Radio *radio, class AudioBase *audio);
     ~Demod();
 
 private:
     class Radio *radio;
-    class Audio *audio;
+    class AudioBase *audio;
     class Agc *agc;
 
     bool cwr;
@@ -55,26 +56,61 @@ private:
     qreal resamplePos;
     qreal resampleRate;
     QVector<REAL> resampleTable;
+    QVector<float> resampleOut;
+
+    // Rate correction from the speaker buffer
+    static constexpr qreal DRIFT_REPORT_SECS = 10;
+    ClockDrift drift;
+    qreal driftRate;
+    qreal driftProduced;
+    qreal driftStart;
+    int driftReportBlocks;
+    int driftReportCount;
+
+    // S-meter state
+    static constexpr qreal SMETER_ATTACK = 0.010;
+    static constexpr qreal SMETER_DECAY = 0.500;
+    static constexpr qreal SMETER_INTERVAL = 0.100;
+    qreal smeterAttack;
+    qreal smeterDecay;
+    qreal smeterLevel;
+    qreal dbOffset;
+    int smeterBlocks;
+    int smeterCount;
 
     // temporary work space
     QVector<COMPLEX> tempData;
 
+    // Capture blocks dropped by a full queue
+    quint32 nextSequence;
+    quint32 blocksLost;
+    // Current block's capture time and blocks since the last one
+    qint64 blockNs;
+    int blockSteps;
+
 signals:
+    void smeterUpdate(qreal);
+    void clockDriftUpdate(qreal ppm);
 
 public slots:
     void setGain(int v);
     void setFilter(int hz);
     void setTone(int hz);
     void setCwr(bool r);
-    void demod(COMPLEX *data);
+    void setDbOffset(qreal db);
+    void setClockDrift(qreal ppm);
+    void demodQueued();
 
 private:
-    void mixAndDecimate(COMPLEX *inData, COMPLEX *outData);
+    void demod(const COMPLEX *data);
+    void mixAndDecimate(const COMPLEX *inData, COMPLEX *outData);
     void configureFirOvSvMixer();
     void configureFirOvSvFilter();
     void firOvSv(COMPLEX *inData, COMPLEX *outData);
+    void smeter(COMPLEX *data);
     void setupResampler();
     void resample(COMPLEX *inData);
+    void updateRate(int written);
 
 };
 
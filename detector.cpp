@@ -0,0 +1,80 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "detector.h"
+#include "noisefloor.h"
+
+Detector::Detector(int bins, qreal binSize) :
+    bins(bins),
+    binSize(binSize),
+    presence(bins),
+    transitions(bins),
+    snr(bins),
+    on(bins)
+{
+}
+
+void Detector::setBinSize(qreal hz)
+{
+    binSize = hz;
+    presence.fill(0);
+    transitions.fill(0);
+    snr.fill(0);
+    on.fill(false);
+}
+
+void Detector::process(const REAL *db, const NoiseFloor &floor)
+{
+    // Per-bin history: how often it is on, how often it
+    // changes state, and the SNR while it is on.
+    for (int i = 0; i < bins; ++i) {
+        REAL s = db[i] - floor.binDb(i);
+        bool o = s > ON_DB;
+        presence[i] += AVERAGE * ((o ? 1 : 0) - presence[i]);
+        transitions[i] += AVERAGE * ((o != on[i] ? 1 : 0) - transitions[i]);
+        if (o) snr[i] += AVERAGE * (s - snr[i]);
+        on[i] = o;
+    }
+
+    // Cluster runs of present bins, allowing a one bin gap
+    m_signals.clear();
+    int i = 0;
+    while (i < bins) {
+        if (presence[i] < PRESENCE_MIN) {
+            ++i;
+            continue;
+        }
+        int start = i, end = i;
+        while (end + 1 < bins && (presence[end+1] >= PRESENCE_MIN ||
+                                  (end + 2 < bins && presence[end+2] >= PRESENCE_MIN))) {
+            ++end;
+        }
+        i = end + 1;
+        if (end - start + 1 > MAX_WIDTH) continue;
+        qreal weight = 0, center = 0;
+        CwSignal sig = {0, 0, 0};
+        for (int b = start; b <= end; ++b) {
+            qreal w = presence[b] * std::max<REAL>(snr[b], 0);
+            weight += w;
+            center += w * b;
+            sig.snr = std::max<qreal>(sig.snr, snr[b]);
+            sig.activity = std::max<qreal>(sig.activity, transitions[b]);
+        }
+        if (weight <= 0) continue;
+        sig.offset = (center / weight - bins / 2) * binSize;
+        m_signals.append(sig);
+    }
+}
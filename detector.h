@@ -0,0 +1,59 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DETECTOR_H
+#define DETECTOR_H
+
+#include <QtCore>
+#include "dsp.h"
+
+// One detected signal. Offset is in Hz from the center of the
+// spectrum view. Activity is near 0 for a steady carrier and
+// rises toward 1 as keying gets faster.
+struct CwSignal {
+    qreal offset;
+    qreal snr;
+    qreal activity;
+};
+
+// Finds bins that keep coming up over the noise floor
+// and clusters them into a short list of signals.
+class Detector
+{
+public:
+    Detector(int bins, qreal binSize);
+    void process(const REAL *db, const class NoiseFloor &floor);
+    void setBinSize(qreal hz);
+    inline const QVector<CwSignal> &signalList() const {
+        return m_signals;
+    }
+
+private:
+    static constexpr REAL ON_DB = 10.0f;
+    static constexpr REAL AVERAGE = 0.1f;
+    static constexpr REAL PRESENCE_MIN = 0.2f;
+    static const int MAX_WIDTH = 12;
+
+    int bins;
+    qreal binSize;
+    QVector<REAL> presence;
+    QVector<REAL> transitions;
+    QVector<REAL> snr;
+    QVector<bool> on;
+    QVector<CwSignal> m_signals;
+};
+
+#endif // DETECTOR_H
@@ -28,6 +28,13 @@
 #define DEMODSIZE (1024)
 #define DEMODRATE (48000)
 
+// Taps in the widely-linear FIR that corrects frequency
+// dependent IQ imbalance. Must be a power of two.
+#define IQFIRSIZE (16)
+
+// dB levels in the spectrum persistence histogram.
+#define PERSISTLEVELS (128)
+
 // Types used for DSP/FFT bulk work.
 // Note that we'll use qreal where we want the most accurate number
 // the platform does natively. Useful for NCOs and other non-array things.
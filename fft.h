@@ -42,6 +42,12 @@
 //     std::array<std::complex<double>,64> in;
 //     std::array<std::complex<double>,64> out;
 //     FFT::dft(in, out);
+//
+// Only bins 10, 200 and 300, when a few dozen at most are wanted:
+//
+//     size_t bins[3] = {10, 200, 300};
+//     std::complex<float> out[3];
+//     FFT::dft(data, bins, 3, out);
 
 namespace FFT {
 
@@ -75,6 +81,16 @@ const std::array<std::complex<T>, N/4> Twiddle<T, D, N>::t3(
     *reinterpret_cast<std::array<std::complex<T>, N/4>*>(twiddles<T>(3,D,N).data())
 );
 
+// Every twiddle around the circle, for single bins.
+template<typename T, int D, size_t N>
+struct Circle {
+    static const std::array<std::complex<T>, N> w;
+};
+template<typename T, int D, size_t N>
+const std::array<std::complex<T>, N> Circle<T, D, N>::w(
+    *reinterpret_cast<std::array<std::complex<T>, N>*>(twiddles<T>(4,D,N*4).data())
+);
+
 // Recursive template for butterfly mixing.
 template<typename T, int D, size_t N>
 class Butterfly {
@@ -196,6 +212,19 @@ class Transform {
     }
     static constexpr size_t pattern_size = pattern_size_impl(N,1);
     static const BitReverse<pattern_size, ispow4> bit;
+    // Smallest butterfly block the bin transform runs to.
+    static constexpr size_t block_size_impl(size_t n) {
+        return (n > 32) ? block_size_impl(n >> 2) : n;
+    }
+    static constexpr size_t block_size = block_size_impl(N);
+    static size_t reverse(size_t v, size_t n) {
+        size_t r = 0;
+        for (size_t m = 1; m < n; m <<= 1) {
+            r = (r << 1) | (v & 1);
+            v >>= 1;
+        }
+        return r;
+    }
     static void reindex(std::array<std::complex<T>, N> &data) {
         size_t j1, k1;
         constexpr size_t m = bit.pattern.size();
@@ -299,6 +328,35 @@ public:
         reindex(in, out);
         Butterfly<T, -1, N>::mix(&out[0]);
     }
+    // After reindex each block of Q holds a decimated input in bit
+    // reversed order, so mixing the blocks gives P small transforms.
+    // Each wanted bin then sums its column of those with twiddles,
+    // P multiplies instead of the remaining full butterfly stages.
+    static void dft(std::array<std::complex<T>, N> &data, const size_t *bins, size_t count, std::complex<T> *out) {
+        constexpr size_t Q = block_size;
+        constexpr size_t P = N / Q;
+        const std::array<std::complex<T>, N> &w = Circle<T, -1, N>::w;
+        reindex(data);
+        for (size_t b = 0; b < P; ++b) {
+            Butterfly<T, -1, Q>::mix(&data[b*Q]);
+        }
+        size_t phase[P];
+        for (size_t b = 0; b < P; ++b) {
+            phase[b] = reverse(b, P);
+        }
+        for (size_t j = 0; j < count; ++j) {
+            const size_t k = bins[j];
+            const std::complex<T> *col = &data[k & (Q-1)];
+            T re = 0, im = 0;
+            for (size_t b = 0; b < P; ++b) {
+                const std::complex<T> &z = col[b*Q];
+                const std::complex<T> &t = w[(phase[b] * k) & (N-1)];
+                re += z.real()*t.real() - z.imag()*t.imag();
+                im += z.imag()*t.real() + z.real()*t.imag();
+            }
+            out[j] = std::complex<T>(re, im);
+        }
+    }
     static void idft(const std::array<std::complex<T>, N> &in, std::array<std::complex<T>, N> &out) {
         reindex(in, out);
         Butterfly<T, 1, N>::mix(&out[0]);
@@ -330,6 +388,22 @@ inline void dft(const std::complex<T> (&in)[N], std::complex<T> (&out)[N]) {
                          *reinterpret_cast<std::array<std::complex<T>, N>*>(&out));
 }
 
+/// Discrete Fourier transform of count listed bins into out.
+/// Cheaper than the full transform for a few dozen bins.
+/// Leaves data scrambled.
+template<typename T, size_t N>
+inline void dft(std::array<std::complex<T>, N> &data, const size_t *bins, size_t count, std::complex<T> *out) {
+    Transform<T, N>::dft(data, bins, count, out);
+}
+
+/// Discrete Fourier transform of count listed bins into out.
+/// Cheaper than the full transform for a few dozen bins.
+/// Leaves data scrambled.
+template<typename T, size_t N>
+inline void dft(std::complex<T> (&data)[N], const size_t *bins, size_t count, std::complex<T> *out) {
+    Transform<T, N>::dft(*reinterpret_cast<std::array<std::complex<T>, N>*>(&data), bins, count, out);
+}
+
 /// Inverse discrete Fourier transform.
 template<typename T, size_t N>
 inline void idft(std::array<std::complex<T>, N> &data) {
@@ -0,0 +1,82 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "framepacer.h"
+
+constexpr qreal FramePacer::MIN_FPS;
+
+FramePacer::FramePacer(int sampleRate) :
+    m_sampleRate(sampleRate),
+    m_targetFps(20),
+    pending(0),
+    busyUs(0),
+    lateCount(0),
+    m_skipped(0),
+    m_fps(20),
+    count(0),
+    waiting(false),
+    fixed(false)
+{
+}
+
+void FramePacer::setTargetFps(int fps)
+{
+    m_targetFps = qMax(1, fps);
+}
+
+// Returns true when a frame should be requested now.
+void FramePacer::setFixedFps(int fps)
+{
+    m_fps = qMax(1, fps);
+    fixed = true;
+}
+
+bool FramePacer::tick(int samples)
+{
+    count += samples;
+    if (count < m_sampleRate / m_fps) return false;
+    if (pending.load()) {
+        if (!waiting) {
+            waiting = true;
+            m_skipped.fetchAndAddRelaxed(1);
+        }
+        return false;
+    }
+    waiting = false;
+    count = 0;
+    if (!fixed) adapt();
+    pending = 1;
+    return true;
+}
+
+// Consumer finished the last request. busyUs is how long it took
+// and late is set when the UI had not taken the previous frame.
+void FramePacer::done(int us, bool late)
+{
+    busyUs = us;
+    if (late) lateCount.fetchAndAddRelaxed(1);
+    pending = 0;
+}
+
+void FramePacer::adapt()
+{
+    qreal target = m_targetFps.load();
+    qreal fps = m_fps + RECOVER * (target - m_fps);
+    if (lateCount.fetchAndStoreRelaxed(0)) fps = m_fps * LATE_BACKOFF;
+    int us = busyUs.load();
+    if (us > 0) fps = qMin(fps, BUSY_LIMIT * 1e6 / us);
+    m_fps = qBound(MIN_FPS, fps, qMax(MIN_FPS, target));
+}
@@ -0,0 +1,71 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <QtCore>
+
+// Decides when the audio thread should ask for another spectrum frame.
+// Only one request is ever in flight; frames that come due while the
+// consumer is busy merge into the next request, which then uses the
+// newest samples. The rate backs off from the target when the consumer
+// is slow or the UI drops frames, and recovers slowly. A fixed rate
+// never adapts, so frames fall on the same samples every run.
+//
+// tick() is for the producer thread. done() only touches atomics so
+// it can be called directly from the consumer thread.
+
+class FramePacer
+{
+public:
+    explicit FramePacer(int sampleRate);
+    void setTargetFps(int fps);
+    void setFixedFps(int fps);
+    bool tick(int samples);
+    void done(int busyUs, bool late);
+    inline qreal fps() const {
+        return m_fps;
+    }
+    // Frame periods merged while waiting on the consumer
+    inline quint32 skipped() const {
+        return m_skipped.load();
+    }
+
+private:
+    // Keep the consumer busy no more than this fraction of the time
+    static constexpr qreal BUSY_LIMIT = 0.5;
+    // Rate multiplier when the UI drops a frame
+    static constexpr qreal LATE_BACKOFF = 0.8;
+    // Fraction of the way back to the target per frame
+    static constexpr qreal RECOVER = 0.05;
+    static constexpr qreal MIN_FPS = 2;
+
+    void adapt();
+
+    int m_sampleRate;
+    QAtomicInt m_targetFps;
+    QAtomicInt pending;
+    QAtomicInt busyUs;
+    QAtomicInt lateCount;
+    QAtomicInteger<quint32> m_skipped;
+    qreal m_fps;
+    int count;
+    bool waiting;
+    bool fixed;
+};
+
+#endif // FRAMEPACER_H
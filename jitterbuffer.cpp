@@ -0,0 +1,88 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "jitterbuffer.h"
+#include <climits>
+
+constexpr qreal JitterBuffer::MIN_MARGIN;
+constexpr qreal JitterBuffer::MAX_MARGIN;
+
+JitterBuffer::JitterBuffer() :
+    underrunRate(1),
+    margin(MIN_MARGIN)
+{
+    setRate(48000);
+}
+
+// Starts over from the old fixed target
+void JitterBuffer::setRate(qreal sampleRate)
+{
+    m_rate = sampleRate;
+    goal = setpoint = START_SECS * m_rate;
+    burst = lastBurst = START_SECS * m_rate;
+    lastLevel = -1;
+    windowFrames = windowUnderruns = windowBurst = 0;
+    windowReads = windowSum = 0;
+    windowMin = INT_MAX;
+    lastDip = 0;
+    publish();
+}
+
+void JitterBuffer::setUnderrunRate(qreal perMinute)
+{
+    underrunRate = perMinute;
+}
+
+void JitterBuffer::update(int level, int frames)
+{
+    if (lastLevel >= 0) windowBurst = std::max(windowBurst, level - lastLevel);
+    lastLevel = std::max(0, level - frames);
+    windowMin = std::min(windowMin, level - frames);
+    windowSum += level;
+    windowReads++;
+    windowFrames += frames;
+
+    // Don't wait for the window to raise the goal by the shortfall
+    if (level < frames) {
+        windowUnderruns++;
+        goal = std::min(std::max(goal, setpoint + frames - level), MAX_SECS * m_rate);
+    }
+
+    if (windowFrames >= WINDOW_SECS * m_rate) {
+        qreal dip = (qreal)windowSum / windowReads - windowMin;
+        qreal allowed = underrunRate * windowFrames / m_rate / 60;
+        if (windowUnderruns > allowed) margin = std::min(MAX_MARGIN, margin + MARGIN_STEP);
+        else if (!windowUnderruns) margin = std::max(MIN_MARGIN, margin * MARGIN_DECAY);
+        goal = std::max(dip, lastDip) * (1 + margin);
+        goal = qBound(MIN_SECS * m_rate, goal, MAX_SECS * m_rate);
+        burst = std::max(windowBurst, lastBurst);
+        lastDip = dip;
+        lastBurst = windowBurst;
+        windowFrames = windowUnderruns = windowBurst = 0;
+        windowReads = windowSum = 0;
+        windowMin = INT_MAX;
+    }
+
+    qreal secs = goal > setpoint ? RISE_SECS : FALL_SECS;
+    setpoint += (goal - setpoint) * std::min(1.0, frames / (secs * m_rate));
+    publish();
+}
+
+void JitterBuffer::publish()
+{
+    m_target = qRound(setpoint);
+    m_overrunLevel = qRound(setpoint * OVERRUN_FACTOR) + burst;
+}
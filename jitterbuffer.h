@@ -0,0 +1,91 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef JITTERBUFFER_H
+#define JITTERBUFFER_H
+
+#include <QtCore>
+
+// Picks the speaker buffer level the resampler aims for. Just before
+// each speaker read the level is what demod has delivered less what
+// the device has taken, so how far it dips below its mean covers
+// both the callback timing variance and demod block arrival jitter.
+// The rise since the previous read measures the demod bursts.
+//
+// The target follows the deepest dip of the last two windows plus a
+// margin. The margin grows after a window with more underruns than
+// allowed and shrinks after one with none, so it settles on the
+// smallest target that holds the configured underrun rate. The
+// setpoint slews toward the target, quickly up and slowly down, so
+// the resampler rate never steps.
+
+class JitterBuffer
+{
+public:
+    JitterBuffer();
+    void setRate(qreal sampleRate);
+    inline qreal rate() const {
+        return m_rate;
+    }
+    void setUnderrunRate(qreal perMinute);
+
+    // Speaker thread, before each read
+    void update(int level, int frames);
+
+    // Any thread, in frames
+    inline int target() const {
+        return m_target.load();
+    }
+    // Above this demod is running ahead, not just bursting
+    inline int overrunLevel() const {
+        return m_overrunLevel.load();
+    }
+
+private:
+    static constexpr qreal START_SECS = 0.030;
+    static constexpr qreal MIN_SECS = 0.004;
+    static constexpr qreal MAX_SECS = 0.200;
+    static constexpr qreal WINDOW_SECS = 2.0;
+    static constexpr qreal MIN_MARGIN = 0.1;
+    static constexpr qreal MAX_MARGIN = 2.0;
+    static constexpr qreal MARGIN_STEP = 0.25;
+    static constexpr qreal MARGIN_DECAY = 0.9;
+    static constexpr qreal RISE_SECS = 0.5;
+    static constexpr qreal FALL_SECS = 5.0;
+    static constexpr qreal OVERRUN_FACTOR = 2.5;
+
+    void publish();
+
+    qreal m_rate;
+    qreal underrunRate;
+    qreal margin;
+    qreal goal;
+    qreal setpoint;
+    int burst;
+    int lastLevel;
+    int windowFrames;
+    int windowUnderruns;
+    int windowReads;
+    qint64 windowSum;
+    int windowMin;
+    qreal lastDip;
+    int windowBurst;
+    int lastBurst;
+    QAtomicInt m_target;
+    QAtomicInt m_overrunLevel;
+};
+
+#endif // JITTERBUFFER_H
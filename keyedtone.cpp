@@ -0,0 +1,111 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "keyedtone.h"
+
+const int KeyedTone::CHUNK;
+
+KeyedTone::KeyedTone() :
+    phase(0.0, 1.0),
+    step(0),
+    tableStep(-1),
+    powRe(CHUNK),
+    powIm(CHUNK)
+{
+    samples = 0;
+    shapePos = 0;
+    volume = 0;
+}
+
+void KeyedTone::setShape(int size)
+{
+    shape.resize(size);
+    int i = 1;
+    for (auto &v : shape) {
+        v = 0.5 - 0.5 * cos(M_PI*i/(size+1));
+        ++i;
+    }
+    if (shapePos) shapePos = size;
+    else shapePos = 0;
+}
+
+void KeyedTone::setStep(qreal radians)
+{
+    step = radians;
+}
+
+void KeyedTone::restart()
+{
+    if (!samples && !shapePos) {
+        phase = std::complex<qreal>(0.0, 1.0);
+    }
+}
+
+// Frame k of a chunk is the base phasor advanced k+1 steps
+void KeyedTone::updateTable()
+{
+    tableStep = step;
+    for (int k = 0; k < CHUNK; k++) {
+        powRe[k] = cos(tableStep * (k + 1));
+        powIm[k] = sin(tableStep * (k + 1));
+    }
+}
+
+int KeyedTone::render(int frames, qreal amplitude)
+{
+    if (env.size() < frames) {
+        env.resize(frames);
+        outRe.resize(frames);
+        outIm.resize(frames);
+    }
+    if (step != tableStep) updateTable();
+
+    REAL *e = env.data();
+    const int size = shape.size();
+    int i = 0, pos = shapePos, samps = samples;
+    if (samps > frames) samps = frames;
+
+    // Begin with window shape
+    while (pos < size && i < samps) e[i++] = shape[pos++];
+    // Continuous tone
+    while (i < samps) e[i++] = 1;
+    // Anything sent so far is considered for the timing.
+    samples -= i;
+    if (samples < 0) samples = 0;
+    // End with window shape
+    if (!samples) {
+        while (pos && i < frames) e[i++] = shape[--pos];
+    }
+    shapePos = pos;
+
+    const REAL *pr = powRe.constData();
+    const REAL *pi = powIm.constData();
+    for (int done = 0; done < i; done += CHUNK) {
+        int len = std::min(CHUNK, i - done);
+        const REAL br = phase.real() * amplitude;
+        const REAL bi = phase.imag() * amplitude;
+        const REAL *ce = e + done;
+        REAL *re = outRe.data() + done;
+        REAL *im = outIm.data() + done;
+        for (int k = 0; k < len; k++) {
+            re[k] = (br * pr[k] - bi * pi[k]) * ce[k];
+            im[k] = (br * pi[k] + bi * pr[k]) * ce[k];
+        }
+        phase *= std::polar(1.0, tableStep * len);
+        phase /= std::abs(phase);
+    }
+    return i;
+}
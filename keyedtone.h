@@ -0,0 +1,74 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef KEYEDTONE_H
+#define KEYEDTONE_H
+
+#include <QtCore>
+#include "dsp.h"
+
+// A keyed carrier with raised cosine edges, rendered a block at a
+// time for the sidetone and the transmitter. The oscillator is a
+// table of the first powers of the step times a base phasor that is
+// advanced and renormalized once per chunk. The loops are plain
+// float on split arrays so they vectorize, the phase is continuous
+// across blocks and the amplitude can't drift.
+
+class KeyedTone
+{
+public:
+    KeyedTone();
+
+    // Key down frames still to send, set by AudioBase::sendElement
+    QAtomicInt samples;
+    // Position on the edge, zero is silent
+    QAtomicInt shapePos;
+    qreal volume;
+
+    void setShape(int size);
+    inline int shapeSize() const {
+        return shape.size();
+    }
+    void setStep(qreal radians);
+    // Called before a new element, starts from a fixed phase when idle
+    void restart();
+
+    // Tone scaled by amplitude goes to the front of re() and im(),
+    // returns how many frames that is. The rest is silence.
+    int render(int frames, qreal amplitude);
+    inline const REAL *re() const {
+        return outRe.constData();
+    }
+    inline const REAL *im() const {
+        return outIm.constData();
+    }
+
+private:
+    static const int CHUNK = 256;
+    void updateTable();
+
+    QVector<REAL> shape;
+    std::complex<qreal> phase;
+    qreal step;
+    qreal tableStep;
+    QVector<REAL> powRe;
+    QVector<REAL> powIm;
+    QVector<REAL> env;
+    QVector<REAL> outRe;
+    QVector<REAL> outIm;
+};
+
+#endif // KEYEDTONE_H
@@ -19,14 +19,31 @@
 #include "radio.h"
 #include "mainwindow.h"
 #include "settingsform.h"
+#include "plotbenchmark.h"
+#include "binsbenchmark.h"
 #include "dsp.h"
 
 int main(int argc, char *argv[])
 {
     qRegisterMetaType<REAL>("TYPEREAL");
     qRegisterMetaType<COMPLEX>("COMPLEX");
+    qRegisterMetaType<QVector<COMPLEX>>("QVector<COMPLEX>");
+    qRegisterMetaType<QVector<CwSignal>>("QVector<CwSignal>");
+    qRegisterMetaType<ViewFrames*>("ViewFrames*");
+    qRegisterMetaType<SpectrumFrames*>("SpectrumFrames*");
+    qRegisterMetaType<PersistenceFrames*>("PersistenceFrames*");
+
+    bool benchmark = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!qstrcmp(argv[i], "--benchmark-bins")) return BinsBenchmark::run();
+        if (!qstrcmp(argv[i], "--benchmark-plot")) benchmark = true;
+    }
+    if (benchmark && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
 
     QApplication a(argc, argv);
+    if (benchmark) return PlotBenchmark::run();
 
     QLocale::setDefault(QLocale::system());
 
@@ -16,6 +16,7 @@
 
 #include "mainwindow.h"
 #include "spectrumplot.h"
+#include "waterfallplot.h"
 #include "freq.h"
 #include "radio.h"
 
@@ -33,6 +34,7 @@ MainWindow::MainWindow(Radio *radio)
     setWindowTitle(QStringLiteral("Peaberry CW"));
 
     auto spectrumplot = new SpectrumPlot(this);
+    auto waterfall = new WaterfallPlot(this);
 
     tuner = new Freq(" Hz");
     QFont font(tuner->font());
@@ -52,7 +54,9 @@ MainWindow::MainWindow(Radio *radio)
     // Controls
 
     smeter = new QLabel(QStringLiteral(""));
-    auto zoom = new QCheckBox(QStringLiteral("Zoom"));
+    zoom = new QComboBox();
+    auto autoScale = new QCheckBox(QStringLiteral("Auto"));
+    auto persistence = new QCheckBox(QStringLiteral("Persist"));
     auto zerobeat = new QPushButton(QStringLiteral("Zero Beat"));
     zerobeat->setEnabled(false);
     auto settingsButton = new QPushButton(QStringLiteral("Settings"));
@@ -81,6 +85,13 @@ MainWindow::MainWindow(Radio *radio)
     agc->addItem(QStringLiteral("Slow"), 0.900);
     agc->addItem(QStringLiteral("Long"), 1.500);
 
+    zoom->addItem(QStringLiteral("Full"), 0);
+    zoom->addItem(QStringLiteral("1x"), 1);
+    zoom->addItem(QStringLiteral("2x"), 2);
+    zoom->addItem(QStringLiteral("4x"), 4);
+    zoom->addItem(QStringLiteral("8x"), 8);
+    zoom->addItem(QStringLiteral("16x"), 16);
+
     xitrit->addItem(QStringLiteral("Off"), 0);
     xitrit->addItem(QStringLiteral("XIT"), 1);
     xitrit->addItem(QStringLiteral("RIT"), 2);
@@ -92,11 +103,15 @@ MainWindow::MainWindow(Radio *radio)
     connect(agc, SIGNAL(currentIndexChanged(int)), this, SLOT(agcHandler(int)));
     connect(filter, SIGNAL(currentIndexChanged(int)), this, SLOT(filterHandler(int)));
     connect(xitrit, SIGNAL(currentIndexChanged(int)), this, SLOT(xitritHandler(int)));
+    connect(zoom, SIGNAL(currentIndexChanged(int)), this, SLOT(zoomHandler(int)));
 
     // Layout
 
     auto scopeHBox = new QHBoxLayout();
+    scopeHBox->addWidget(new QLabel(QStringLiteral("Zoom")));
     scopeHBox->addWidget(zoom);
+    scopeHBox->addWidget(autoScale);
+    scopeHBox->addWidget(persistence);
     scopeHBox->addSpacerItem(
         new QSpacerItem(0, 0, QSizePolicy::MinimumExpanding, QSizePolicy::Fixed)
     );
@@ -148,6 +163,7 @@ MainWindow::MainWindow(Radio *radio)
     central_vbox->setMargin(0);
     setLayout(central_vbox);
     central_vbox->addWidget(spectrumplot);
+    central_vbox->addWidget(waterfall);
     central_vbox->addLayout(central_hbox);
 
     // Compute spacing for info areas
@@ -164,17 +180,34 @@ MainWindow::MainWindow(Radio *radio)
 
     // Connect to radio
     connect(radio, SIGNAL(dbOffsetChanged(qreal)), spectrumplot, SLOT(setDbOffset(qreal)));
-    connect(radio, SIGNAL(spectrumViewUpdate(QVector<qreal>*)),
-            spectrumplot, SLOT(setData(QVector<qreal>*)));
+    connect(radio, SIGNAL(spectrumViewUpdate(ViewFrames*)),
+            spectrumplot, SLOT(setData(ViewFrames*)));
+    connect(radio, SIGNAL(waterfallUpdate(SpectrumFrames*)),
+            waterfall, SLOT(setData(SpectrumFrames*)));
+    connect(radio, SIGNAL(persistenceUpdate(PersistenceFrames*)),
+            spectrumplot, SLOT(setPersistenceData(PersistenceFrames*)));
+    connect(spectrumplot, SIGNAL(scaleChanged(int,int)), waterfall, SLOT(setScale(int,int)));
+    connect(spectrumplot, SIGNAL(scaleChanged(int,int)), radio, SIGNAL(spectrumScaleUpdate(int,int)));
 
     connect(radio, SIGNAL(colorsChanged(int)), spectrumplot, SLOT(setTheme(int)));
+    connect(radio, SIGNAL(colorsChanged(int)), waterfall, SLOT(setTheme(int)));
 
     connect(this, SIGNAL(keyerValueChanged(int)), radio, SLOT(setSpeed(int)));
     connect(radio, SIGNAL(speedChanged(int)), keyerSlider, SLOT(setValue(int)));
 
-    connect(zoom, SIGNAL(toggled(bool)), radio, SLOT(setFftZoom(bool)));
-    connect(radio, SIGNAL(fftZoomChanged(bool)), zoom, SLOT(setChecked(bool)));
-    connect(radio, SIGNAL(fftZoomChanged(bool)), spectrumplot, SLOT(setZoom(bool)));
+    connect(this, SIGNAL(zoomValueChanged(int)), radio, SLOT(setFftZoom(int)));
+    connect(radio, SIGNAL(fftZoomChanged(int)), this, SLOT(setZoomValue(int)));
+    connect(radio, SIGNAL(fftZoomChanged(int)), spectrumplot, SLOT(setZoom(int)));
+    connect(radio, SIGNAL(fftZoomChanged(int)), waterfall, SLOT(clear()));
+
+    connect(autoScale, SIGNAL(toggled(bool)), radio, SLOT(setFftAutoScale(bool)));
+    connect(radio, SIGNAL(fftAutoScaleChanged(bool)), autoScale, SLOT(setChecked(bool)));
+    connect(radio, SIGNAL(fftAutoScaleChanged(bool)), spectrumplot, SLOT(setAutoScale(bool)));
+    connect(persistence, SIGNAL(toggled(bool)), radio, SLOT(setFftPersistence(bool)));
+    connect(radio, SIGNAL(fftPersistenceChanged(bool)), persistence, SLOT(setChecked(bool)));
+    connect(radio, SIGNAL(fftPersistenceChanged(bool)), spectrumplot, SLOT(setPersistence(bool)));
+    connect(radio, SIGNAL(signalListUpdate(QVector<CwSignal>)),
+            spectrumplot, SLOT(setSignalList(QVector<CwSignal>)));
 
     connect(radio, SIGNAL(gainChanged(int)), gain, SLOT(setValue(int)));
     connect(gain, SIGNAL(valueChanged(int)), radio, SLOT(setGain(int)));
@@ -191,6 +224,8 @@ MainWindow::MainWindow(Radio *radio)
     connect(radio, SIGNAL(smeterUpdate(qreal)), this, SLOT(setSmeter(qreal)));
 
     connect(spectrumplot, SIGNAL(freqAdjusted(qreal)), this, SLOT(freqAdjusted(qreal)));
+    connect(spectrumplot, SIGNAL(widthChanged(int)), radio, SIGNAL(spectrumWidthUpdate(int)));
+    connect(spectrumplot, SIGNAL(visibilityChanged(bool)), radio, SIGNAL(spectrumVisibleUpdate(bool)));
     connect(spectrumplot, SIGNAL(offsetAdjusted(qreal)), this, SLOT(offsetAdjusted(qreal)));
 
     connect(this, SIGNAL(powerValueChanged(int)), radio, SLOT(setPower(int)));
@@ -234,18 +269,16 @@ void MainWindow::setFilterValue(int v)
     emit filterValueChanged(filter->currentData().toInt());
 }
 
+void MainWindow::setZoomValue(int v)
+{
+    int index = zoom->findData(v);
+    if (index < 0) index = zoom->findData(1);
+    zoom->setCurrentIndex(index);
+}
+
 void MainWindow::setSmeter(qreal v)
 {
-    //TODO this is all temporary junk until
-    // a proper S-meter is created
-    static qreal stickyValue = -999;
-    static int stickyCountdown = 0;
-    if (stickyCountdown && v < stickyValue) {
-        --stickyCountdown;
-        return;
-    }
-    stickyValue = v;
-    stickyCountdown = 30; // 1 secs
+    // Ballistics are done in Demod
     QString s("S");
     if (v >= -63) {
         s.append("9+");
@@ -302,6 +335,11 @@ void MainWindow::filterHandler(int)
     emit filterValueChanged(filterval);
 }
 
+void MainWindow::zoomHandler(int)
+{
+    emit zoomValueChanged(zoom->currentData().toInt());
+}
+
 void MainWindow::freqAdjusted(qreal delta)
 {
     qint64 newf;
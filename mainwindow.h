@@ -32,6 +32,7 @@ signals:
     void keyerValueChanged(int);
     void agcValueChanged(qreal);
     void filterValueChanged(int);
+    void zoomValueChanged(int);
     void xitValueChanged(qint64);
     void ritValueChanged(qint64);
     void showSettings();
@@ -40,6 +41,7 @@ public slots:
     void setKeyerValue(int wpm);
     void setAgcValue(qreal v);
     void setFilterValue(int v);
+    void setZoomValue(int v);
     void setSmeter(qreal v);
 
 private slots:
@@ -47,6 +49,7 @@ private slots:
     void keyerHandler(int);
     void agcHandler(int);
     void filterHandler(int);
+    void zoomHandler(int);
     void freqAdjusted(qreal delta);
     void offsetAdjusted(qreal delta);
     void xitritHandler(int);
@@ -64,6 +67,7 @@ private:
     class QSlider *gain;
     class QComboBox *filter;
     class QComboBox *xitrit;
+    class QComboBox *zoom;
     class Freq *tuner;
     class Freq *offset;
 
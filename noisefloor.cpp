@@ -0,0 +1,74 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "noisefloor.h"
+#include "bins.h"
+#include <cfloat>
+
+NoiseFloor::NoiseFloor(int bins, int groupSize) :
+    m_groupSize(groupSize),
+    groups(bins / groupSize),
+    smoothed(groups),
+    subMin(groups),
+    windowMin(groups),
+    history(groups * SUBWINDOWS),
+    floor(groups, FLT_MAX),
+    m_groupDb(groups)
+{
+    reset();
+}
+
+void NoiseFloor::reset()
+{
+    first = true;
+    frames = 0;
+    historyPos = 0;
+    subMin.fill(FLT_MAX);
+    windowMin.fill(FLT_MAX);
+    history.fill(FLT_MAX);
+    floor.fill(FLT_MAX);
+}
+
+void NoiseFloor::process(const REAL *power)
+{
+    for (int g = 0; g < groups; ++g) {
+        REAL p = 0, clip = floor[g] * CLIP;
+        for (int i = 0; i < m_groupSize; ++i) p += std::min(power[i], clip);
+        power += m_groupSize;
+        p /= m_groupSize;
+        if (first) smoothed[g] = p;
+        else smoothed[g] += SMOOTH * (p - smoothed[g]);
+        subMin[g] = std::min(subMin[g], smoothed[g]);
+        floor[g] = std::min(windowMin[g], subMin[g]) * BIAS;
+    }
+    first = false;
+
+    if (++frames >= SUBWINDOW_FRAMES) {
+        // Retire the oldest sub-window
+        frames = 0;
+        REAL *h = &history[historyPos * groups];
+        for (int g = 0; g < groups; ++g) h[g] = subMin[g];
+        historyPos = (historyPos + 1) % SUBWINDOWS;
+        windowMin.fill(FLT_MAX);
+        for (int s = 0; s < SUBWINDOWS; ++s) {
+            h = &history[s * groups];
+            for (int g = 0; g < groups; ++g) windowMin[g] = std::min(windowMin[g], h[g]);
+        }
+        subMin.fill(FLT_MAX);
+    }
+
+    Bins::powerToDb(floor.data(), m_groupDb.data(), groups, 0);
+}
@@ -0,0 +1,68 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef NOISEFLOOR_H
+#define NOISEFLOOR_H
+
+#include <QtCore>
+#include "dsp.h"
+
+// Minimum statistics noise floor estimate for groups of bins.
+// Each frame costs one pass over the bins. The minimum of the
+// smoothed group power is tracked over a window made of
+// sub-windows so old minimums can expire.
+
+class NoiseFloor
+{
+public:
+    NoiseFloor(int bins, int groupSize);
+    void process(const REAL *power);
+    void reset();
+    inline int groupSize() const {
+        return m_groupSize;
+    }
+    // Noise floor in dB for each group of bins
+    inline const QVector<REAL> &groupDb() const {
+        return m_groupDb;
+    }
+    inline REAL binDb(int bin) const {
+        return m_groupDb[bin / m_groupSize];
+    }
+
+private:
+    static const int SUBWINDOWS = 6;
+    static const int SUBWINDOW_FRAMES = 5;
+    static constexpr REAL SMOOTH = 0.3f;
+    // Minimum of smoothed noise is below its mean
+    static constexpr REAL BIAS = 1.2f;
+    // Bins this far over the last floor are clipped so a
+    // steady carrier doesn't raise the floor of its group
+    static constexpr REAL CLIP = 4.0f;
+
+    int m_groupSize;
+    int groups;
+    int frames;
+    int historyPos;
+    bool first;
+    QVector<REAL> smoothed;
+    QVector<REAL> subMin;
+    QVector<REAL> windowMin;
+    QVector<REAL> history;
+    QVector<REAL> floor;
+    QVector<REAL> m_groupDb;
+};
+
+#endif // NOISEFLOOR_H
@@ -29,6 +29,12 @@ win32 {
     LIBS += -lole32 -lwinmm -lavrt
 }
 
+unix:!macx {
+    SOURCES += audio_linux.cpp
+    HEADERS += audio_linux.h
+    LIBS += -lasound -lusb
+}
+
 TEMPLATE = app
 
 SOURCES += \
@@ -40,13 +46,25 @@ SOURCES += \
     freq.cpp \
     settingsform.cpp \
     spectrumplot.cpp \
+    waterfallplot.cpp \
+    plotbenchmark.cpp \
+    binsbenchmark.cpp \
     spectrum.cpp \
     agc.cpp \
+    noisefloor.cpp \
+    detector.cpp \
+    framepacer.cpp \
     demod.cpp \
-    audio.cpp
+    keyedtone.cpp \
+    jitterbuffer.cpp \
+    clockdrift.cpp \
+    audio.cpp \
+    audio_file.cpp
 
 HEADERS  += \
     dsp.h \
+    bins.h \
+    capture.h \
     radio.h \
     cat.h \
     keyer.h \
@@ -55,10 +73,23 @@ HEADERS  += \
     fft.h \
     settingsform.h \
     spectrumplot.h \
+    waterfallplot.h \
+    plotbenchmark.h \
+    binsbenchmark.h \
     spectrum.h \
     agc.h \
+    noisefloor.h \
+    detector.h \
+    triplebuffer.h \
+    samplering.h \
+    blockqueue.h \
+    framepacer.h \
     demod.h \
-    audio.h
+    keyedtone.h \
+    jitterbuffer.h \
+    clockdrift.h \
+    audio.h \
+    audio_file.h
 
 FORMS    += \
     settingsform.ui
@@ -0,0 +1,109 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "plotbenchmark.h"
+#include "spectrumplot.h"
+#include <QGuiApplication>
+#include <QResizeEvent>
+#include <algorithm>
+#include <random>
+
+int PlotBenchmark::run()
+{
+    QTextStream out(stdout);
+    const QSize sizes[] = {QSize(640, 200), QSize(1280, 300), QSize(1920, 400), QSize(3840, 800)};
+    const int zooms[] = {0, 1, 16};
+    const int themes = (int)SpectrumPlot::Theme::Horne + 1;
+
+    // The plot keeps pointers to these between paints
+    ViewFrames frames;
+    PersistenceFrames persistFrames;
+    SpectrumPlot plot(nullptr);
+    plot.finishPaint = true;
+    plot.resize(sizes[0]);
+    if (plot.grabFramebuffer().isNull()) {
+        out << "No OpenGL context for " << QGuiApplication::platformName() << endl;
+        return EXIT_FAILURE;
+    }
+    plot.makeCurrent();
+    out << "Renderer " << (const char *)plot.glGetString(GL_RENDERER) << endl;
+    plot.doneCurrent();
+    out << "size      theme zoom persist   p50us   p90us   p99us   maxus" << endl;
+    for (const QSize &size : sizes) {
+        // A hidden widget gets no resize event of its own
+        plot.resize(size);
+        QResizeEvent resize(size, QSize());
+        QCoreApplication::sendEvent(&plot, &resize);
+        for (int theme = 0; theme < themes; ++theme) {
+            plot.setTheme(theme);
+            for (int zoom : zooms) {
+                for (bool persist : {false, true}) {
+                    // Persistence is mostly fill rate so one theme is enough
+                    if (persist && theme) continue;
+                    QVector<qint64> ns = paint(plot, frames, persistFrames, zoom, persist);
+                    std::sort(ns.begin(), ns.end());
+                    auto pct = [&ns](int p) {
+                        return QString::number(ns[(ns.size() - 1) * p / 100] / 1000).rightJustified(8);
+                    };
+                    out << QString("%1x%2").arg(size.width()).arg(size.height()).leftJustified(10)
+                        << QString::number(theme).rightJustified(5)
+                        << QString::number(zoom).rightJustified(5)
+                        << QString(persist ? "yes" : "no").rightJustified(8)
+                        << pct(50) << pct(90) << pct(99) << pct(100) << endl;
+                }
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
+
+// Noise with a few keyed carriers, one point per pixel like Spectrum
+// sends. The plot times its own paint through glFinish so GPU work
+// counts and the framebuffer read back does not.
+QVector<qint64> PlotBenchmark::paint(SpectrumPlot &plot, ViewFrames &frames,
+                                     PersistenceFrames &persistFrames, int zoom, bool persist)
+{
+    std::minstd_rand rng(zoom);
+    std::uniform_real_distribution<REAL> noise(0, 6);
+    std::uniform_int_distribution<int> level(0, 255);
+    const int points = qMin(plot.width(), zoom ? 2560 : 8192);
+    plot.setZoom(zoom);
+    plot.setPersistence(persist);
+    plot.grabFramebuffer();
+
+    QVector<qint64> ns;
+    for (int frame = 0; frame < WARMUP + FRAMES; ++frame) {
+        QVector<REAL> &view = frames.back().points;
+        view.resize(points);
+        frames.back().floor.fill(-117, points);
+        for (auto &v : view) v = -120 + noise(rng);
+        for (int c = 1; c < 8; ++c) {
+            if ((frame >> (c % 4)) & 1) view[points * c / 8] = -70 + c;
+        }
+        frames.publish();
+        plot.setData(&frames);
+        if (persist) {
+            QVector<quint8> &hist = persistFrames.back();
+            hist.resize(points * PERSISTLEVELS);
+            for (auto &h : hist) h = level(rng);
+            persistFrames.publish();
+            plot.setPersistenceData(&persistFrames);
+        }
+        plot.grabFramebuffer();
+        if (frame >= WARMUP) ns.append(plot.lastPaintNs);
+    }
+    return ns;
+}
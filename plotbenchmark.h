@@ -0,0 +1,42 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PLOTBENCHMARK_H
+#define PLOTBENCHMARK_H
+
+#include <QtCore>
+#include "triplebuffer.h"
+
+// Renders SpectrumPlot with synthetic frames at several sizes,
+// themes and zooms and prints paint time percentiles. Run with
+// --benchmark-plot, which uses the offscreen platform unless
+// QT_QPA_PLATFORM says otherwise so it works on a headless box.
+
+class PlotBenchmark
+{
+public:
+    static int run();
+
+private:
+    // Frames timed for each configuration after the warm up
+    static const int FRAMES = 100;
+    static const int WARMUP = 10;
+
+    static QVector<qint64> paint(class SpectrumPlot &plot, ViewFrames &frames,
+                                 PersistenceFrames &persistFrames, int zoom, bool persist);
+};
+
+#endif // PLOTBENCHMARK_H
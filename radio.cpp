@@ -19,6 +19,7 @@
 #include "demod.h"
 #include "spectrum.h"
 #include "audio.h"
+#include "audio_file.h"
 #include <QSettings>
 
 #ifdef Q_OS_WIN32
@@ -45,24 +46,33 @@ Radio::Radio(QObject *parent) :
     connect(&demodThread, &QThread::started, &FastDenormals::enable);
     connect(&spectrumThread, &QThread::started, &FastDenormals::enable);
 
-    cat = new Cat(this);
-    if (!cat->error.isEmpty()) {
-        error = cat->error;
-        return;
+    // Simulation replaces both the radio and its sound card
+    QStringList args = QCoreApplication::arguments();
+    bool simulation = AudioFile::requested(args);
+    radioGroup = "Simulation";
+
+    if (!simulation) {
+        cat = new Cat(this);
+        if (!cat->error.isEmpty()) {
+            error = cat->error;
+            return;
+        }
+        cat->moveToThread(&ioThread);
+        connect(&ioThread, &QThread::started, cat, &Cat::start);
+        connect(&ioThread, &QThread::finished, cat, &Cat::stop);
+        connect(&ioThread, &QThread::finished, cat, &QObject::deleteLater);
+        radioGroup = cat->serialNumber;
     }
-    cat->moveToThread(&ioThread);
-    connect(&ioThread, &QThread::started, cat, &Cat::start);
-    connect(&ioThread, &QThread::finished, cat, &Cat::stop);
-    connect(&ioThread, &QThread::finished, cat, &QObject::deleteLater);
 
-    audio_ = new Audio(this);
+    if (simulation) audio_ = new AudioFile(this, args);
+    else audio_ = new Audio(this);
     if (!audio_->error.isEmpty()) {
         error = audio_->error;
         return;
     }
     audio_->moveToThread(&ioThread);
-    connect(&ioThread, &QThread::started, audio_, &Audio::start);
-    connect(&ioThread, &QThread::finished, audio_, &Audio::stop);
+    connect(&ioThread, SIGNAL(started()), audio_, SLOT(start()));
+    connect(&ioThread, SIGNAL(finished()), audio_, SLOT(stop()));
     connect(&ioThread, &QThread::finished, audio_, &QObject::deleteLater);
 
     demod = new Demod(this, audio_);
@@ -73,13 +83,22 @@ Radio::Radio(QObject *parent) :
     spectrum->moveToThread(&spectrumThread);
     connect(&spectrumThread, &QThread::finished, spectrum, &QObject::deleteLater);
 
+    // A fast simulation waits for each block to be used
+    // instead of dropping it.
+    Qt::ConnectionType update = Qt::AutoConnection;
+    if (simulation && static_cast<AudioFile*>(audio_)->fast()) {
+        update = Qt::BlockingQueuedConnection;
+    }
+
     // Critical signals that we don't want to pass through UI queue
-    connect(cat, SIGNAL(sendElement(qreal,qreal)), audio_, SLOT(sendElement(qreal,qreal)));
+    if (cat) {
+        connect(cat, SIGNAL(sendElement(qreal,qreal)), audio_, SLOT(sendElement(qreal,qreal)));
+        connect(audio_, SIGNAL(transmitPaddingUpdate(qreal)),
+                cat, SLOT(setTransmitPadding(qreal)));
+    }
     connect(audio_, SIGNAL(spectrumUpdate(COMPLEX*,COMPLEX*,quint16)),
-            spectrum, SLOT(spectrumUpdate(COMPLEX*,COMPLEX*,quint16)));
-    connect(audio_, SIGNAL(demodUpdate(COMPLEX*)), demod, SLOT(demod(COMPLEX*)));
-    connect(audio_, SIGNAL(transmitPaddingUpdate(qreal)),
-            cat, SLOT(setTransmitPadding(qreal)));
+            spectrum, SLOT(spectrumUpdate(COMPLEX*,COMPLEX*,quint16)), update);
+    connect(audio_, SIGNAL(demodReady()), demod, SLOT(demodQueued()), update);
 
     demodThread.start(QThread::HighestPriority);
     spectrumThread.start(QThread::HighPriority);
@@ -115,14 +134,19 @@ void Radio::save()
         settings_->setValue("colors", m_colors);
         settings_->setValue("window", m_window);
         settings_->setValue("fftFilter", m_fftSmooth);
-        settings_->setValue("fftZoom", m_fftZoom);
+        settings_->setValue("fftAverage", m_fftAverage);
+        settings_->setValue("fftZoomFactor", m_fftZoom);
+        settings_->setValue("fftAutoScale", m_fftAutoScale);
+        settings_->setValue("fftPersistence", m_fftPersistence);
+        settings_->setValue("fftFps", m_fftFps);
+        settings_->setValue("waterfallRate", m_waterfallRate);
         settings_->setValue("gain", m_gain);
         settings_->setValue("agcSpeed", m_agcSpeed);
         settings_->setValue("filter", m_filter);
         settings_->setValue("cwr", m_cwr);
         settings_->setValue("qsk", m_qsk);
         // Begin radio-specific settings
-        settings_->beginGroup(cat->serialNumber);
+        settings_->beginGroup(radioGroup);
         settings_->setValue("freq", m_freq);
         settings_->setValue("xit", m_xit);
         settings_->setValue("rit", m_rit);
@@ -130,6 +154,7 @@ void Radio::save()
         settings_->setValue("power", m_power);
         settings_->setValue("phase", m_txPhase);
         settings_->setValue("gain", m_txGain);
+        settings_->setValue(clockDriftKey(), m_clockDrift);
         settings_->endGroup();
         settings_->sync();
     }
@@ -199,9 +224,29 @@ void Radio::load()
     m_fftSmooth = tmpInt + 1;
     setFftFilter(tmpInt);
 
-    tmpBool = settings_->value("fftZoom", false).toBool();
-    m_fftZoom = !tmpBool;
-    setFftZoom(tmpBool);
+    tmpInt = settings_->value("fftAverage", 0).toInt();
+    m_fftAverage = tmpInt + 1;
+    setFftAverage(tmpInt);
+
+    tmpInt = settings_->value("fftZoomFactor", 1).toInt();
+    m_fftZoom = tmpInt + 1;
+    setFftZoom(tmpInt);
+
+    tmpBool = settings_->value("fftAutoScale", false).toBool();
+    m_fftAutoScale = !tmpBool;
+    setFftAutoScale(tmpBool);
+
+    tmpBool = settings_->value("fftPersistence", false).toBool();
+    m_fftPersistence = !tmpBool;
+    setFftPersistence(tmpBool);
+
+    tmpInt = settings_->value("fftFps", 20).toInt();
+    m_fftFps = tmpInt + 1;
+    setFftFps(tmpInt);
+
+    tmpInt = settings_->value("waterfallRate", 10).toInt();
+    m_waterfallRate = tmpInt + 1;
+    setWaterfallRate(tmpInt);
 
     tmpInt = settings_->value("gain", 50).toInt();
     m_gain = tmpInt + 1;
@@ -224,7 +269,7 @@ void Radio::load()
     setQsk(tmpInt);
 
     // Begin radio-specific settings
-    settings_->beginGroup(cat->serialNumber);
+    settings_->beginGroup(radioGroup);
 
     tmpInt = settings_->value("freq", 14060000).toInt();
     m_freq = tmpInt + 1;
@@ -254,11 +299,25 @@ void Radio::load()
     m_txGain = tmpDouble + 1;
     setTxGain(tmpDouble);
 
+    tmpDouble = settings_->value(clockDriftKey(), 0.0).toDouble();
+    m_clockDrift = tmpDouble + 1;
+    setClockDrift(tmpDouble);
+
     settings_->endGroup();
 
     settingsLoaded = true;
 }
 
+// The drift belongs to the pair of clocks, so it's saved in the
+// radio group under the speaker device.
+QString Radio::clockDriftKey()
+{
+    QString device = audio_->speakerKey;
+    if (device.isEmpty()) device = "Default";
+    device.replace('/', '_').replace('\\', '_');
+    return "clockDrift/" + device;
+}
+
 void Radio::setSpeed(int wpm)
 {
     bool changed = (m_speed != wpm);
@@ -357,13 +416,48 @@ void Radio::setFftFilter(int v)
     if (changed) emit(fftFilterChanged(v));
 }
 
-void Radio::setFftZoom(bool z)
+void Radio::setFftAverage(int v)
+{
+    bool changed = (m_fftAverage != v);
+    m_fftAverage = v;
+    if (changed) emit(fftAverageChanged(v));
+}
+
+void Radio::setFftZoom(int z)
 {
     bool changed = (m_fftZoom != z);
     m_fftZoom = z;
     if (changed) emit(fftZoomChanged(z));
 }
 
+void Radio::setFftAutoScale(bool a)
+{
+    bool changed = (m_fftAutoScale != a);
+    m_fftAutoScale = a;
+    if (changed) emit(fftAutoScaleChanged(a));
+}
+
+void Radio::setFftPersistence(bool p)
+{
+    bool changed = (m_fftPersistence != p);
+    m_fftPersistence = p;
+    if (changed) emit(fftPersistenceChanged(p));
+}
+
+void Radio::setFftFps(int fps)
+{
+    bool changed = (m_fftFps != fps);
+    m_fftFps = fps;
+    if (changed) emit(fftFpsChanged(fps));
+}
+
+void Radio::setWaterfallRate(int lps)
+{
+    bool changed = (m_waterfallRate != lps);
+    m_waterfallRate = lps;
+    if (changed) emit(waterfallRateChanged(lps));
+}
+
 void Radio::setGain(int v)
 {
     bool changed = (m_gain != v);
@@ -441,6 +535,13 @@ void Radio::setTxGain(qreal gain)
     if (changed) emit(txGainChanged(gain));
 }
 
+void Radio::setClockDrift(qreal ppm)
+{
+    bool changed = (m_clockDrift != ppm);
+    m_clockDrift = ppm;
+    if (changed) emit(clockDriftChanged(ppm));
+}
+
 void Radio::setQsk(int ms)
 {
     bool changed = (m_qsk != ms);
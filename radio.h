@@ -18,6 +18,9 @@
 #define RADIO_H
 
 #include <QtCore>
+#include "dsp.h"
+#include "detector.h"
+#include "triplebuffer.h"
 
 class Radio : public QObject
 {
@@ -35,21 +38,31 @@ public:
 protected:
     class QSettings *settings_;
     bool settingsLoaded;
+    // Settings group for the radio-specific values
+    QString radioGroup;
 
     QThread ioThread;
     QThread demodThread;
     QThread spectrumThread;
 
     class Cat *cat;
-    class Audio *audio_;
+    class AudioBase *audio_;
     class Demod *demod;
     class Spectrum *spectrum;
 
 signals: // unsaved glue
-    void spectrumViewUpdate(QVector<qreal>*);
+    void spectrumViewUpdate(ViewFrames*);
+    void waterfallUpdate(SpectrumFrames*);
+    void persistenceUpdate(PersistenceFrames*);
+    void spectrumScaleUpdate(int minDb, int rangeDb);
     void rxIqBalUpdate(qreal phase, qreal gain);
     void rxDcBiasUpdate(qreal phase, qreal gain);
+    void rxIqFirUpdate(QVector<COMPLEX> taps);
     void smeterUpdate(qreal);
+    void signalListUpdate(QVector<CwSignal> list);
+    void spectrumWidthUpdate(int pixels);
+    void spectrumVisibleUpdate(bool visible);
+    void spectrumDone(int busyUs, bool late);
 
 private:
     int m_speed;
@@ -66,7 +79,12 @@ private:
     int m_window;
     qreal m_shape;
     int m_fftSmooth;
-    bool m_fftZoom;
+    int m_fftAverage;
+    int m_fftZoom;
+    bool m_fftAutoScale;
+    bool m_fftPersistence;
+    int m_fftFps;
+    int m_waterfallRate;
     int m_gain;
     qreal m_agcSpeed;
     int m_filter;
@@ -78,8 +96,11 @@ private:
     int m_power;
     qreal m_txPhase;
     qreal m_txGain;
+    qreal m_clockDrift;
     int m_qsk;
 
+    QString clockDriftKey();
+
 signals: // saved config
     void speedChanged(int wpm);
     void keyVolumeChanged(int v);
@@ -95,7 +116,12 @@ signals: // saved config
     void colorsChanged(int c);
     void windowChanged(int w);
     void fftFilterChanged(int v);
-    void fftZoomChanged(bool z);
+    void fftAverageChanged(int v);
+    void fftZoomChanged(int z);
+    void fftAutoScaleChanged(bool a);
+    void fftPersistenceChanged(bool p);
+    void fftFpsChanged(int fps);
+    void waterfallRateChanged(int lps);
     void gainChanged(int v);
     void agcSpeedChanged(qreal m);
     void filterChanged(int hz);
@@ -107,6 +133,7 @@ signals: // saved config
     void powerChanged(int p);
     void txPhaseChanged(qreal phase);
     void txGainChanged(qreal gain);
+    void clockDriftChanged(qreal ppm);
     void qskChanged(int ms);
 
 public slots:
@@ -124,7 +151,12 @@ public slots:
     void setColors(int c);
     void setWindow(int w);
     void setFftFilter(int v);
-    void setFftZoom(bool z);
+    void setFftAverage(int v);
+    void setFftZoom(int z);
+    void setFftAutoScale(bool a);
+    void setFftPersistence(bool p);
+    void setFftFps(int fps);
+    void setWaterfallRate(int lps);
     void setGain(int v);
     void setAgcSpeed(qreal m);
     void setFilter(int hz);
@@ -136,6 +168,7 @@ public slots:
     void setPower(int p);
     void setTxPhase(qreal phase);
     void setTxGain(qreal gain);
+    void setClockDrift(qreal ppm);
     void setQsk(int ms);
 };
 
@@ -0,0 +1,114 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SAMPLERING_H
+#define SAMPLERING_H
+
+#include <QtCore>
+#include <algorithm>
+
+// Lock-free stream of samples from one writer thread to one reader
+// thread. Each side owns a position that only ever increases and
+// wraps through the power of two size. A side publishes its position
+// with release after touching the samples and loads the other side's
+// with acquire before touching them, so a whole block crosses with
+// one atomic store. Samples a full ring can't take, or that skip()
+// throws away, count as an overrun. Reads that come up short count
+// as an underrun.
+
+class SampleRing
+{
+public:
+    explicit SampleRing(int size) :
+        buffer(size),
+        mask(size - 1),
+        m_head(0),
+        m_tail(0),
+        m_overruns(0),
+        m_underruns(0)
+    {
+        Q_ASSERT(size > 0 && !(size & mask));
+    }
+
+    // Writer side, returns how many were stored
+    int write(const float *data, int count) {
+        quint32 head = m_head.load();
+        int space = buffer.size() - (int)(head - m_tail.loadAcquire());
+        if (count > space) {
+            m_overruns.fetchAndAddRelaxed(1);
+            count = space;
+        }
+        float *buf = buffer.data();
+        int first = std::min(count, buffer.size() - (int)(head & mask));
+        std::copy(data, data + first, buf + (head & mask));
+        std::copy(data + first, data + count, buf);
+        m_head.storeRelease(head + count);
+        return count;
+    }
+
+    // Reader side, returns how many were copied to data
+    int read(float *data, int count) {
+        quint32 tail = m_tail.load();
+        int level = m_head.loadAcquire() - tail;
+        if (count > level) {
+            m_underruns.fetchAndAddRelaxed(1);
+            count = level;
+        }
+        const float *buf = buffer.constData();
+        int first = std::min(count, buffer.size() - (int)(tail & mask));
+        std::copy(buf + (tail & mask), buf + (tail & mask) + first, data);
+        std::copy(buf, buf + count - first, data + first);
+        m_tail.storeRelease(tail + count);
+        return count;
+    }
+
+    // Reader side, drops the oldest samples
+    int skip(int count) {
+        quint32 tail = m_tail.load();
+        count = std::min(count, (int)(m_head.loadAcquire() - tail));
+        if (count <= 0) return 0;
+        m_overruns.fetchAndAddRelaxed(1);
+        m_tail.storeRelease(tail + count);
+        return count;
+    }
+
+    // Exact for the calling side's own position, so it never
+    // overstates what the reader can take or the writer can store.
+    inline int fill() const {
+        return (int)(m_head.loadAcquire() - m_tail.loadAcquire());
+    }
+    inline int size() const {
+        return buffer.size();
+    }
+
+    // Instrumentation, safe from any thread
+    inline quint32 overruns() const {
+        return m_overruns.load();
+    }
+    inline quint32 underruns() const {
+        return m_underruns.load();
+    }
+
+private:
+    QVector<float> buffer;
+    const quint32 mask;
+    QAtomicInteger<quint32> m_head;
+    QAtomicInteger<quint32> m_tail;
+    QAtomicInteger<quint32> m_overruns;
+    QAtomicInteger<quint32> m_underruns;
+};
+
+#endif // SAMPLERING_H
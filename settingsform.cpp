@@ -57,6 +57,13 @@ SettingsForm::SettingsForm(Radio *radio, QWidget *parent) :
     connect(radio, SIGNAL(fftFilterChanged(int)), ui->fftFilterSlider, SLOT(setValue(int)));
     connect(ui->fftFilterSlider, SIGNAL(valueChanged(int)), radio, SLOT(setFftFilter(int)));
 
+    connect(radio, SIGNAL(fftAverageChanged(int)), ui->averageComboBox, SLOT(setCurrentIndex(int)));
+    connect(ui->averageComboBox, SIGNAL(currentIndexChanged(int)), radio, SLOT(setFftAverage(int)));
+    connect(radio, SIGNAL(fftFpsChanged(int)), ui->fpsSpinBox, SLOT(setValue(int)));
+    connect(ui->fpsSpinBox, SIGNAL(valueChanged(int)), radio, SLOT(setFftFps(int)));
+    connect(radio, SIGNAL(waterfallRateChanged(int)), ui->lineRateSpinBox, SLOT(setValue(int)));
+    connect(ui->lineRateSpinBox, SIGNAL(valueChanged(int)), radio, SLOT(setWaterfallRate(int)));
+
     connect(radio, SIGNAL(keyMemoryChanged(int)), ui->keyMemoryComboBox, SLOT(setCurrentIndex(int)));
     connect(ui->keyMemoryComboBox, SIGNAL(currentIndexChanged(int)), radio, SLOT(setKeyMemory(int)));
 
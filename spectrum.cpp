@@ -17,22 +17,50 @@
 #include "spectrum.h"
 #include "radio.h"
 #include "fft.h"
+#include "bins.h"
 #include "dsp.h"
 
+constexpr qreal Spectrum::IQ_FIR_ADAPT;
+
 Spectrum::Spectrum(Radio *radio) :
+    zoomBuf(65536),
+    zoomWin(8192),
     sincWin(49152),
     basicWin(8192),
     fftBuf(8192),
-    iirBuf(8192),
-    fftAbs(2560),
+    binPower(VIEW_BINS),
+    binDb(VIEW_BINS),
+    iirBuf(VIEW_BINS),
+    fftAbs(VIEW_BINS),
+    noiseFloor(VIEW_BINS, 32),
+    detector(VIEW_BINS, 96000.0 / 8192),
     iqSignalFinder(8192),
     iqRawData(8192),
-    iqDataInTest(8192)
+    iqDataInTest(8192),
+    iqBins(5120),
+    iqBinData(5120),
+    iqFirResponse(IQFIRSIZE),
+    iqFirTaps(IQFIRSIZE)
 {
+    m_pixels = 0;
+    m_visible = true;
+    idleCount = 0;
+    framesDropped = 0;
+    lineCount = 0;
+    nextLineNs = 0;
+    lineTimer.start();
+    setLineRate(10);
+    m_persistence = false;
+    persistReset = true;
+    persistMinDb = -100;
+    persistRangeDb = 110;
+    persistNs = 0;
+
     setIir(50);
-    setFilter(500);
+    setAverage(0);
     setDbOffset(0);
     setWindow(0);
+    setZoom(1);
 
     // Compute sinc window for polyphase FFT
     qreal len, prd, n;
@@ -47,28 +75,119 @@ Spectrum::Spectrum(Radio *radio) :
         ++n;
     }
 
-    connect(this, SIGNAL(spectrumViewUpdate(QVector<qreal>*)),
-            radio, SIGNAL(spectrumViewUpdate(QVector<qreal>*)));
+    // Zoom always uses a hann window since the polyphase
+    // window would span many seconds at high zoom.
+    len = zoomWin.size() - 1;
+    n = 0;
+    zoomWinSum = 0;
+    for (auto &v : zoomWin) {
+        v = .5 - .5 * cos((2*M_PI*n)/len);
+        zoomWinSum += v;
+        ++n;
+    }
+
+    connect(this, SIGNAL(spectrumViewUpdate(ViewFrames*)),
+            radio, SIGNAL(spectrumViewUpdate(ViewFrames*)));
+    connect(this, SIGNAL(waterfallUpdate(SpectrumFrames*)),
+            radio, SIGNAL(waterfallUpdate(SpectrumFrames*)));
+    connect(this, SIGNAL(persistenceUpdate(PersistenceFrames*)),
+            radio, SIGNAL(persistenceUpdate(PersistenceFrames*)));
+    connect(this, SIGNAL(signalListUpdate(QVector<CwSignal>)),
+            radio, SIGNAL(signalListUpdate(QVector<CwSignal>)));
 
     connect(radio, SIGNAL(fftFilterChanged(int)), this, SLOT(setIir(int)));
-    connect(radio, SIGNAL(filterChanged(int)), this, SLOT(setFilter(int)));
+    connect(radio, SIGNAL(fftAverageChanged(int)), this, SLOT(setAverage(int)));
+    connect(radio, SIGNAL(fftZoomChanged(int)), this, SLOT(setZoom(int)));
+    connect(radio, SIGNAL(spectrumWidthUpdate(int)), this, SLOT(setPixels(int)));
+    connect(radio, SIGNAL(spectrumVisibleUpdate(bool)), this, SLOT(setViewVisible(bool)));
+    connect(radio, SIGNAL(waterfallRateChanged(int)), this, SLOT(setLineRate(int)));
+    connect(radio, SIGNAL(fftPersistenceChanged(bool)), this, SLOT(setPersistence(bool)));
+    connect(radio, SIGNAL(spectrumScaleUpdate(int,int)), this, SLOT(setScale(int,int)));
     connect(radio, SIGNAL(windowChanged(int)), this, SLOT(setWindow(int)));
     connect(radio, SIGNAL(dbOffsetChanged(qreal)), this, SLOT(setDbOffset(qreal)));
 
     connect(this, SIGNAL(iqBalUpdate(qreal,qreal)), radio, SIGNAL(rxIqBalUpdate(qreal,qreal)));
     connect(this, SIGNAL(dcBiasUpdate(qreal,qreal)), radio, SIGNAL(rxDcBiasUpdate(qreal,qreal)));
-    connect(this, SIGNAL(smeterUpdate(qreal)), radio, SIGNAL(smeterUpdate(qreal)));
+    connect(this, SIGNAL(iqFirUpdate(QVector<COMPLEX>)), radio, SIGNAL(rxIqFirUpdate(QVector<COMPLEX>)));
+    connect(this, SIGNAL(spectrumDone(int,bool)), radio, SIGNAL(spectrumDone(int,bool)),
+            Qt::DirectConnection);
 }
 
 void Spectrum::setIir(int v)
 {
-    iir = -1.0 / ((v+1)/5.0);
+    iir = 1.0 - exp(-1.0 / ((v+1)/5.0));
+}
+
+void Spectrum::setAverage(int v)
+{
+    m_average = (Average)v;
+    averageReset = true;
 }
 
-void Spectrum::setFilter(int hz)
+// Zoom of 0 is the full bandwidth view
+void Spectrum::setZoom(int z)
 {
-    // temporary for s-meter hack
-    m_filter = hz + 75;
+    m_full = (z == 0);
+    int bins = m_full ? FULL_BINS : VIEW_BINS;
+    binPower.resize(bins);
+    binDb.resize(bins);
+    iirBuf.resize(bins);
+    fftAbs.resize(bins);
+    zoomStages = 0;
+    while (zoomStages < ZOOM_STAGES && (2 << zoomStages) <= z) ++zoomStages;
+    m_zoom = 1 << zoomStages;
+    for (auto &hb : zoomFilter) {
+        std::fill(hb.buf, hb.buf + 22, COMPLEX(0));
+        hb.pos = 0;
+        hb.odd = false;
+    }
+    zoomBuf.fill(0);
+    zoomPos = 0;
+    zoomMix = 0;
+    zoomStarted = false;
+    averageReset = true;
+    noiseFloor.reset();
+    detector.setBinSize(96000.0 / 8192 / m_zoom);
+    lineCount = 0;
+    persistReset = true;
+}
+
+// Width of the plot so no more points are sent than can be drawn
+void Spectrum::setPixels(int px)
+{
+    m_pixels = px;
+}
+
+// Nothing is showing the spectrum
+void Spectrum::setViewVisible(bool v)
+{
+    if (v && !m_visible) {
+        zoomStarted = false;
+        averageReset = true;
+        noiseFloor.reset();
+    }
+    m_visible = v;
+}
+
+// Waterfall lines per second, independent of the frame rate
+void Spectrum::setLineRate(int lps)
+{
+    lineNs = 1000000000LL / qMax(1, lps);
+    nextLineNs = lineTimer.nsecsElapsed();
+}
+
+void Spectrum::setPersistence(bool p)
+{
+    m_persistence = p;
+    persistReset = true;
+}
+
+// Persistence levels follow the plot scale
+void Spectrum::setScale(int minDb, int rangeDb)
+{
+    persistMinDb = minDb;
+    persistRangeDb = qMax(1, rangeDb);
+    persistReset = true;
 }
 
 void Spectrum::setWindow(int w)
@@ -102,12 +221,57 @@ void Spectrum::setDbOffset(qreal db)
     m_dbOffset = db;
 }
 
+// Tell the audio thread how long each frame took and whether
+// the UI is keeping up so it can pace the next request.
 void Spectrum::spectrumUpdate(COMPLEX *raw, COMPLEX *adjusted, quint16 pos)
 {
+    QElapsedTimer timer;
+    timer.start();
+    process(raw, adjusted, pos);
+    quint32 dropped = frames.dropped();
+    emit spectrumDone(timer.nsecsElapsed() / 1000, dropped != framesDropped);
+    framesDropped = dropped;
+}
+
+void Spectrum::process(COMPLEX *raw, COMPLEX *adjusted, quint16 pos)
+{
+    // With no view only the receive corrections are kept up
+    // and at a reduced rate.
+    if (!m_visible) {
+        if (++idleCount < IDLE_DIVIDER) return;
+        idleCount = 0;
+        if (m_zoom > 1) {
+            updateDcBias(raw, pos);
+            return;
+        }
+    }
+
     unsigned int i;
     i = 0;
     qreal winSum;
-    if (m_window) {
+    if (m_zoom > 1) {
+        zoomUpdate(adjusted, pos);
+        winSum = zoomWinSum;
+        quint16 zp = zoomPos - 8192;
+        while (i < 8192) {
+            COMPLEX v = zoomBuf[zp] * zoomWin[i];
+            // Shift by -N/4 bins so the center lands on bin 6144
+            switch (i & 3) {
+            case 1:
+                v = COMPLEX(v.imag(), -v.real());
+                break;
+            case 2:
+                v = -v;
+                break;
+            case 3:
+                v = COMPLEX(-v.imag(), v.real());
+                break;
+            }
+            fftBuf[i] = v;
+            i++;
+            zp++;
+        }
+    } else if (m_window) {
         winSum = basicSum;
         pos -= 8192;
         while (i < 8192) {
@@ -131,40 +295,13 @@ void Spectrum::spectrumUpdate(COMPLEX *raw, COMPLEX *adjusted, quint16 pos)
     }
 
     FFT::dft(*(COMPLEX(*)[8192])fftBuf.data());
-    for (i = 0; i < 2560; ++i) {
-        auto v = fftBuf[i+4864];
-        qreal gain = 1.0 - exp(iir * abs(exp(v)));
-        iirBuf[i] = iirBuf[i] * (1-gain) + abs(v) / winSum * gain;
-        fftAbs[i] = 20 * log10(iirBuf[i]) + m_dbOffset;
-    }
-    emit spectrumViewUpdate(&fftAbs);
-
-    // S-meter is super-cheesy peak reading of FFT.
-    // This will eventually be done with demod analysis.
-    unsigned int smeterHalfWidth = (m_filter+75) / (96000.0 / 8192.0) / 2;
-    qreal smeter = -999;
-    for (i = 6143-smeterHalfWidth; i < 6144+smeterHalfWidth; i++) {
-        qreal v = 20 * log10(abs(fftBuf[i]) / winSum);
-        if (v > smeter) smeter = v;
-    }
-    emit smeterUpdate(smeter + m_dbOffset);
+    if (m_visible) updateView(winSum);
+    COMPLEX dcbias = updateDcBias(raw, pos);
 
-    // Optimistic bias adjustment.
-    // Assumes future samples will be similar to past samples.
-    COMPLEX dcbias;
-    pos -= 49152;
-    for (i=0; i<49152; i++) {
-        dcbias += raw[pos];
-        pos++;
-    }
-    dcbias /= 49152;
-    emit dcBiasUpdate(dcbias.real(), dcbias.imag());
+    // Image bins are not in a zoomed FFT
+    if (m_zoom > 1) return;
 
-    // A signal bin must be 20dB over its mirror for this
-    // many passes in a row before it's used for balancing.
-    // Potential adjustments must also succeed this many
-    // times in a row.
-    const unsigned int sigCountThreshold = 5;
+    updateIqFir();
 
     if (iqBalState == -1) {
         // Hunting for signals we can balance
@@ -180,7 +317,7 @@ void Spectrum::spectrumUpdate(COMPLEX *raw, COMPLEX *adjusted, quint16 pos)
             }
         }
         for (auto v : iqSignalFinder) {
-            if (v>sigCountThreshold) {
+            if (v>IQ_SIG_COUNT_THRESHOLD) {
                 iqVerifyCount = 0;
                 iqBalState = 0;
             }
@@ -238,21 +375,39 @@ void Spectrum::spectrumUpdate(COMPLEX *raw, COMPLEX *adjusted, quint16 pos)
                               );
         }
 
-        FFT::dft(*(COMPLEX(*)[8192])iqDataInTest.data());
+        // Signal bins and their mirrors, in pairs
+        iqBinCount = 0;
+        for (i = 0; i < 2560; ++i) {
+            if (iqSignalFinder[4864+i] > IQ_SIG_COUNT_THRESHOLD ||
+                    iqSignalFinder[3328-i] > IQ_SIG_COUNT_THRESHOLD) {
+                iqBins[iqBinCount++] = 4864+i;
+                iqBins[iqBinCount++] = 3328-i;
+            }
+        }
+        if (iqBinCount <= IQ_PRUNE_BINS) {
+            FFT::dft(*(COMPLEX(*)[8192])iqDataInTest.data(),
+                     iqBins.data(), iqBinCount, iqBinData.data());
+        } else {
+            FFT::dft(*(COMPLEX(*)[8192])iqDataInTest.data());
+            for (int j = 0; j < iqBinCount; ++j) {
+                iqBinData[j] = iqDataInTest[iqBins[j]];
+            }
+        }
         iqBalState++;
         return;
     }
 
     qreal delta = 0;
-    for (i = 0; i < 2560; ++i) {
+    for (int j = 0; j < iqBinCount; j += 2) {
+        i = iqBins[j] - 4864;
         qreal x1, x2;
-        if (iqSignalFinder[4864+i] > sigCountThreshold) {
-            x1 = 20 * log10(std::abs(iqDataInTest[4864+i])/sincSum);
-            x2 = 20 * log10(std::abs(iqDataInTest[3328-i])/sincSum);
+        if (iqSignalFinder[4864+i] > IQ_SIG_COUNT_THRESHOLD) {
+            x1 = 20 * log10(std::abs(iqBinData[j])/sincSum);
+            x2 = 20 * log10(std::abs(iqBinData[j+1])/sincSum);
         }
-        else if (iqSignalFinder[3328-i] > sigCountThreshold) {
-            x2 = 20 * log10(std::abs(iqDataInTest[4864+i])/sincSum);
-            x1 = 20 * log10(std::abs(iqDataInTest[3328-i])/sincSum);
+        else if (iqSignalFinder[3328-i] > IQ_SIG_COUNT_THRESHOLD) {
+            x2 = 20 * log10(std::abs(iqBinData[j])/sincSum);
+            x1 = 20 * log10(std::abs(iqBinData[j+1])/sincSum);
 
         }
         else continue;
@@ -282,7 +437,7 @@ void Spectrum::spectrumUpdate(COMPLEX *raw, COMPLEX *adjusted, quint16 pos)
             iqBalState=-1;
             return;
         }
-        if (iqVerifyCount > sigCountThreshold) {
+        if (iqVerifyCount > IQ_SIG_COUNT_THRESHOLD) {
             // success!
             iqPhase = iqNewPhase;
             iqGain = iqNewGain;
@@ -304,3 +459,238 @@ void Spectrum::spectrumUpdate(COMPLEX *raw, COMPLEX *adjusted, quint16 pos)
     if (iqBalState++ > 30) iqBalState=-1;
 
 }
+
+// Display bins, noise floor and signal list from fftBuf.
+void Spectrum::updateView(qreal winSum)
+{
+    // iirBuf holds power for the Power average and dB for the others
+    const REAL scale = 1.0 / (winSum * winSum);
+    const int bins = binPower.size();
+    if (m_full) {
+        // Negative frequencies first
+        Bins::power(&fftBuf[FULL_BINS/2], binPower.data(), FULL_BINS/2, scale);
+        Bins::power(&fftBuf[0], binPower.data() + FULL_BINS/2, FULL_BINS/2, scale);
+    } else {
+        Bins::power(&fftBuf[VIEW_FIRST], binPower.data(), VIEW_BINS, scale);
+    }
+    Bins::powerToDb(binPower.data(), binDb.data(), bins, 0);
+    if (m_average == Average::Power) {
+        if (averageReset) iirBuf = binPower;
+        Bins::smooth(iirBuf.data(), binPower.data(), bins, iir);
+        Bins::powerToDb(iirBuf.data(), fftAbs.data(), bins, m_dbOffset);
+    } else {
+        if (averageReset) iirBuf = binDb;
+        switch (m_average) {
+        case Average::PeakHold:
+            Bins::peakHold(iirBuf.data(), binDb.data(), bins, HOLD_DB * iir);
+            break;
+        case Average::MinHold:
+            Bins::minHold(iirBuf.data(), binDb.data(), bins, HOLD_DB * iir);
+            break;
+        default: // Log
+            Bins::smooth(iirBuf.data(), binDb.data(), bins, iir);
+            break;
+        }
+        Bins::add(iirBuf.data(), fftAbs.data(), bins, m_dbOffset);
+    }
+    averageReset = false;
+
+    // Noise floor and signals are always for the narrow view
+    const int narrow = m_full ? VIEW_FIRST - FULL_BINS/2 : 0;
+    noiseFloor.process(binPower.data() + narrow);
+
+    // One point per pixel. Min hold is showing the noise so it
+    // averages, everything else keeps the peaks visible.
+    int points = bins;
+    if (m_pixels > 0 && m_pixels < bins) points = m_pixels;
+    SpectrumView &view = frames.back();
+    view.points.resize(points);
+    if (m_average == Average::MinHold) {
+        Bins::reduceMean(fftAbs.data(), bins, view.points.data(), points);
+    } else {
+        Bins::reduceMax(fftAbs.data(), bins, view.points.data(), points);
+    }
+    // Floor of the group at the middle of each point. Full view
+    // points outside the narrow view use the nearest group.
+    view.floor.resize(points);
+    for (int p = 0; p < points; ++p) {
+        int bin = (2 * p + 1) * bins / (2 * points) - narrow;
+        view.floor[p] = noiseFloor.binDb(qBound(0, bin, VIEW_BINS - 1)) + m_dbOffset;
+    }
+    updateLine(view.points);
+    if (m_persistence) updatePersistence(view.points);
+    frames.publish();
+    emit spectrumViewUpdate(&frames);
+
+    detector.process(binDb.data() + narrow, noiseFloor);
+    emit signalListUpdate(detector.signalList());
+}
+
+// Running mean of every frame until a waterfall line is due.
+// A line is never sent twice so a rate faster than the frame
+// rate gives one line per frame.
+void Spectrum::updateLine(const QVector<REAL> &view)
+{
+    const int points = view.size();
+    if (lineAvg.size() != points) {
+        lineAvg.resize(points);
+        lineCount = 0;
+    }
+    if (!lineCount) std::copy(view.constBegin(), view.constEnd(), lineAvg.begin());
+    else Bins::smooth(lineAvg.data(), view.constData(), points, 1.0 / (lineCount + 1));
+    ++lineCount;
+    qint64 now = lineTimer.nsecsElapsed();
+    if (now < nextLineNs) return;
+    nextLineNs += lineNs;
+    if (nextLineNs < now) nextLineNs = now;
+    QVector<REAL> &line = lines.back();
+    line.resize(points);
+    std::copy(lineAvg.constBegin(), lineAvg.constEnd(), line.begin());
+    lines.publish();
+    lineCount = 0;
+    emit waterfallUpdate(&lines);
+}
+
+// Each column of the histogram gets a hit from the level of its
+// point to the level of the point before so the trace is joined.
+// Levels outside the plot are -1 or PERSISTLEVELS and never hit.
+void Spectrum::updatePersistence(const QVector<REAL> &view)
+{
+    const int points = view.size();
+    qint64 now = lineTimer.nsecsElapsed();
+    if (persistReset || persistHist.size() != points * PERSISTLEVELS) {
+        persistReset = false;
+        persistHist.fill(0, points * PERSISTLEVELS);
+        persistLo.resize(points);
+        persistHi.resize(points);
+        persistNs = now;
+    }
+    const qreal scale = PERSISTLEVELS / (qreal)persistRangeDb;
+    int prev = 0;
+    for (int x = 0; x < points; ++x) {
+        int level = qBound(-1, qFloor((view[x] - persistMinDb) * scale), PERSISTLEVELS);
+        if (!x) prev = level;
+        persistLo[x] = qMin(level, prev);
+        persistHi[x] = qMax(level, prev);
+        prev = level;
+    }
+    quint16 keep = qBound(0, qRound(65535 * exp((persistNs - now) / PERSIST_NS)), 65535);
+    persistNs = now;
+    QVector<quint8> &frame = persistFrames.back();
+    frame.resize(points * PERSISTLEVELS);
+    Bins::persist(persistHist.data(), frame.data(), persistLo.constData(), persistHi.constData(),
+                  points, PERSISTLEVELS, keep, PERSIST_HIT);
+    persistFrames.publish();
+    emit persistenceUpdate(&persistFrames);
+}
+
+// Optimistic bias adjustment.
+// Assumes future samples will be similar to past samples.
+COMPLEX Spectrum::updateDcBias(COMPLEX *raw, quint16 pos)
+{
+    COMPLEX dcbias;
+    pos -= 49152;
+    for (int i = 0; i < 49152; i++) {
+        dcbias += raw[pos];
+        pos++;
+    }
+    dcbias /= 49152;
+    emit dcBiasUpdate(dcbias.real(), dcbias.imag());
+    return dcbias;
+}
+
+// Same 11-tap LPF as Demod::mixAndDecimate.
+bool Spectrum::halfBand(HalfBand &hb, COMPLEX in, COMPLEX &out)
+{
+    static const REAL FIR0 = 0.0060431029837374152;
+    static const REAL FIR2 = -0.049372515458761493;
+    static const REAL FIR4 = 0.29332944952052842;
+    static const REAL FIR5 = 0.5;
+
+    if (!hb.pos) hb.pos = 10;
+    else --hb.pos;
+    hb.buf[hb.pos] = hb.buf[hb.pos+11] = in;
+    hb.odd = !hb.odd;
+    if (hb.odd) return false;
+    const COMPLEX *b = &hb.buf[hb.pos];
+    out = FIR0 * (b[0] + b[10]) + FIR2 * (b[2] + b[8]) +
+          FIR4 * (b[4] + b[6]) + FIR5 * b[5];
+    return true;
+}
+
+// Mix the receive frequency to DC and decimate the new samples
+// into zoomBuf. Resolution improves by the zoom factor for the
+// same FFT size.
+void Spectrum::zoomUpdate(COMPLEX *adjusted, quint16 pos)
+{
+    quint16 count = pos - zoomRawPos;
+    if (!zoomStarted) {
+        zoomStarted = true;
+        count = 32768;
+        zoomRawPos = pos - count;
+    }
+    while (count--) {
+        COMPLEX v = adjusted[zoomRawPos++];
+        // Mixing by a quarter of the sample rate is a rotation
+        switch (zoomMix++ & 3) {
+        case 1:
+            v = COMPLEX(-v.imag(), v.real());
+            break;
+        case 2:
+            v = -v;
+            break;
+        case 3:
+            v = COMPLEX(v.imag(), -v.real());
+            break;
+        }
+        bool ready = true;
+        for (int s = 0; ready && s < zoomStages; ++s) {
+            ready = halfBand(zoomFilter[s], v, v);
+        }
+        if (ready) zoomBuf[zoomPos++] = v;
+    }
+}
+
+// The IQ balance above is a single phase/gain pair which only
+// nulls the image well near the signals it was tuned with.
+// Here we measure what image is left in the adjusted data for
+// each region of the spectrum and slowly adapt a complex response
+// that is turned into taps for AudioBase::rxIqFirProcess.
+void Spectrum::updateIqFir()
+{
+    std::complex<qreal> num[IQFIRSIZE];
+    qreal den[IQFIRSIZE] = {};
+    bool found = false;
+
+    for (unsigned int i = 0; i < 2560; ++i) {
+        unsigned int sig;
+        if (iqSignalFinder[4864+i] > IQ_SIG_COUNT_THRESHOLD) sig = 4864+i;
+        else if (iqSignalFinder[3328-i] > IQ_SIG_COUNT_THRESHOLD) sig = 3328-i;
+        else continue;
+        unsigned int img = 8192 - sig;
+        int f = img < 4096 ? (int)img : (int)img - 8192;
+        int region = qRound(f * IQFIRSIZE / 8192.0) & (IQFIRSIZE-1);
+        std::complex<qreal> s = fftBuf[sig];
+        // Residual image relative to the conjugate of its signal
+        num[region] += std::complex<qreal>(fftBuf[img]) * s;
+        den[region] += std::norm(s);
+        found = true;
+    }
+    if (!found) return;
+
+    for (int m = 0; m < IQFIRSIZE; ++m) {
+        if (den[m] > 0) iqFirResponse[m] -= IQ_FIR_ADAPT * num[m] / den[m];
+    }
+
+    // Taps are the inverse DFT of the response, centered on the
+    // delay that AudioBase applies to the direct path.
+    for (int n = 0; n < IQFIRSIZE; ++n) {
+        std::complex<qreal> t;
+        for (int m = 0; m < IQFIRSIZE; ++m) {
+            t += iqFirResponse[m] * std::polar(1.0 / IQFIRSIZE,
+                                               2 * M_PI * m * (n - IQFIRSIZE / 2) / IQFIRSIZE);
+        }
+        iqFirTaps[n] = t;
+    }
+    emit iqFirUpdate(iqFirTaps);
+}
@@ -19,30 +19,105 @@
 
 #include <QtCore>
 #include "dsp.h"
+#include "noisefloor.h"
+#include "detector.h"
+#include "triplebuffer.h"
 
 class Spectrum : public QObject
 {
     Q_OBJECT
 public:
     explicit Spectrum(class Radio *radio);
+    enum class Average : int {
+        Power=0,
+        Log,
+        PeakHold,
+        MinHold
+    };
 
 signals:
-    void spectrumViewUpdate(QVector<qreal>*);
-    void smeterUpdate(qreal);
+    void spectrumViewUpdate(ViewFrames*);
+    void waterfallUpdate(SpectrumFrames*);
+    void persistenceUpdate(PersistenceFrames*);
+    void signalListUpdate(QVector<CwSignal> list);
     void dcBiasUpdate(qreal real, qreal imag);
     void iqBalUpdate(qreal phase, qreal gain);
+    void iqFirUpdate(QVector<COMPLEX> taps);
+    void spectrumDone(int busyUs, bool late);
 
 public slots:
     void setIir(int v);
-    void setFilter(int hz);
+    void setAverage(int v);
+    void setZoom(int z);
+    void setPixels(int px);
+    void setViewVisible(bool v);
+    void setLineRate(int lps);
+    void setPersistence(bool p);
+    void setScale(int minDb, int rangeDb);
     void setWindow(int w);
     void setDbOffset(qreal db);
     void spectrumUpdate(COMPLEX *raw, COMPLEX *adjusted, quint16 pos);
 
 private:
+    // A signal bin must be 20dB over its mirror for this
+    // many passes in a row before it's used for balancing.
+    // Potential adjustments must also succeed this many
+    // times in a row.
+    static const unsigned int IQ_SIG_COUNT_THRESHOLD = 5;
+    static constexpr qreal IQ_FIR_ADAPT = 0.25;
+    // Balance passes transform only the signal bins and their
+    // mirrors up to this many, past that the full FFT is cheaper.
+    static const int IQ_PRUNE_BINS = 64;
+    // Hold decay in dB per frame at full smoothing rate
+    static constexpr qreal HOLD_DB = 10.0;
+    // Persistence fades to 1/e in this time
+    static constexpr qreal PERSIST_NS = 1e9;
+    // Histogram increment for a trace crossing a level
+    static const quint16 PERSIST_HIT = 0x4000;
+    // Only every this many frames are used when nothing is visible
+    static const int IDLE_DIVIDER = 5;
+
+    void process(COMPLEX *raw, COMPLEX *adjusted, quint16 pos);
+    void updateView(qreal winSum);
+    void updateLine(const QVector<REAL> &view);
+    void updatePersistence(const QVector<REAL> &view);
+    COMPLEX updateDcBias(COMPLEX *raw, quint16 pos);
+    void updateIqFir();
+
+    // Narrow view is bins 4864 to 7423 around the receive frequency.
+    // Full view is every bin starting from -48 kHz.
+    static const int VIEW_FIRST = 4864;
+    static const int VIEW_BINS = 2560;
+    static const int FULL_BINS = 8192;
+
+    // Zoom decimates by 2 up to this many times
+    static const int ZOOM_STAGES = 4;
+    struct HalfBand {
+        COMPLEX buf[22];
+        int pos;
+        bool odd;
+    };
+    bool halfBand(HalfBand &hb, COMPLEX in, COMPLEX &out);
+    void zoomUpdate(COMPLEX *adjusted, quint16 pos);
+
     qreal iir;
-    int m_filter;
+    Average m_average;
+    bool averageReset;
     int m_window;
+    int m_zoom;
+    bool m_full;
+    int m_pixels;
+    bool m_visible;
+    int idleCount;
+    int zoomStages;
+    bool zoomStarted;
+    quint16 zoomRawPos;
+    quint16 zoomPos;
+    quint8 zoomMix;
+    qreal zoomWinSum;
+    HalfBand zoomFilter[ZOOM_STAGES];
+    QVector<COMPLEX> zoomBuf;
+    QVector<REAL> zoomWin;
     qreal m_dbOffset;
     qreal sincSum;
     qreal basicSum;
@@ -50,8 +125,30 @@ private:
     QVector<REAL> sincWin;
     QVector<REAL> basicWin;
     QVector<COMPLEX> fftBuf;
+    QVector<REAL> binPower;
+    QVector<REAL> binDb;
     QVector<REAL> iirBuf;
-    QVector<qreal> fftAbs;
+    QVector<REAL> fftAbs;
+    ViewFrames frames;
+    quint32 framesDropped;
+    // Waterfall rows are the mean of the frames since the last row
+    SpectrumFrames lines;
+    QVector<REAL> lineAvg;
+    int lineCount;
+    qint64 lineNs;
+    qint64 nextLineNs;
+    QElapsedTimer lineTimer;
+    bool m_persistence;
+    bool persistReset;
+    int persistMinDb;
+    int persistRangeDb;
+    qint64 persistNs;
+    QVector<quint16> persistHist;
+    QVector<qint16> persistLo;
+    QVector<qint16> persistHi;
+    PersistenceFrames persistFrames;
+    NoiseFloor noiseFloor;
+    Detector detector;
 
     int iqBalState = -1;
     unsigned int iqVerifyCount = 0;
@@ -65,6 +162,11 @@ private:
     QVector<unsigned int> iqSignalFinder;
     QVector<COMPLEX> iqRawData;
     QVector<COMPLEX> iqDataInTest;
+    QVector<size_t> iqBins;
+    QVector<COMPLEX> iqBinData;
+    int iqBinCount = 0;
+    QVector<std::complex<qreal>> iqFirResponse;
+    QVector<COMPLEX> iqFirTaps;
 
 };
 
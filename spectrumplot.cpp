@@ -18,186 +18,536 @@
 #include <QApplication>
 #include <QMouseEvent>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QPainter>
+#include <QOpenGLShaderProgram>
+#include <QVector4D>
+#include <QWindow>
+#include <algorithm>
 
 SpectrumPlot::SpectrumPlot(QWidget *parent) :
-    QGLWidget(parent)
+    QOpenGLWidget(parent),
+    vbo(QOpenGLBuffer::VertexBuffer)
 {
     minDb = -100;
+    manualMinDb = minDb;
+    autoScale = false;
+    noiseFloor = -999;
     rangeDb = 110;
     filter = 500;
-    labels = new QPixmap(0,0);
-    stepSize = 1;
-    firstLine = minDb;
+    zoom = 1;
+    needsRecalc = true;
+    overlayChanged = false;
+    overlayTexture = 0;
+    overlayProgram = nullptr;
     xitrit = false;
     xit = rit = 0;
+    frames = nullptr;
+    points = 0;
+    verticesChanged = false;
+    program = nullptr;
+    persistence = false;
+    persistChanged = false;
+    persistWidth = 0;
+    persistFrames = nullptr;
+    persistTexture = 0;
+    paletteTexture = 0;
+    persistProgram = nullptr;
+    viewVisible = true;
+    lastPaintNs = 0;
+    finishPaint = false;
     setTheme((int)Theme::Winrad);
     setAttribute(Qt::WA_OpaquePaintEvent, true);
 }
 
 SpectrumPlot::~SpectrumPlot()
 {
-    delete labels;
+    makeCurrent();
+    vbo.destroy();
+    if (persistTexture) glDeleteTextures(1, &persistTexture);
+    if (paletteTexture) glDeleteTextures(1, &paletteTexture);
+    if (overlayTexture) glDeleteTextures(1, &overlayTexture);
+    delete program;
+    delete persistProgram;
+    delete overlayProgram;
+    doneCurrent();
+}
+
+// Trace vertices are (bin, dB) and the bottom edge uses a dB far
+// below anything displayed. The vertex shader does the scaling and
+// the fragment shader does the gradient so neither the bin count
+// nor the window size costs anything on the CPU after upload.
+static const char *vertexShader =
+    "attribute vec2 vertex;\n"
+    "uniform float count;\n"
+    "uniform float minDb;\n"
+    "uniform float rangeDb;\n"
+    "void main() {\n"
+    "    gl_Position = vec4(vertex.x / count * 2.0 - 1.0,\n"
+    "                       (vertex.y - minDb) / rangeDb * 2.0 - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+// Gradient runs from stop 0 at the top to stop 2 at the bottom.
+// A line color with alpha 1 overrides it for drawing the trace.
+static const char *fragmentShader =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "uniform float height;\n"
+    "uniform vec4 stopColor[3];\n"
+    "uniform float stopPos[3];\n"
+    "uniform vec4 lineColor;\n"
+    "void main() {\n"
+    "    float t = 1.0 - gl_FragCoord.y / height;\n"
+    "    vec4 c;\n"
+    "    if (t < stopPos[1]) {\n"
+    "        c = mix(stopColor[0], stopColor[1],\n"
+    "                clamp((t - stopPos[0]) / (stopPos[1] - stopPos[0]), 0.0, 1.0));\n"
+    "    } else {\n"
+    "        c = mix(stopColor[1], stopColor[2],\n"
+    "                clamp((t - stopPos[1]) / (stopPos[2] - stopPos[1]), 0.0, 1.0));\n"
+    "    }\n"
+    "    gl_FragColor = mix(c, lineColor, lineColor.a);\n"
+    "}\n";
+
+// Full plot quad for the persistence and overlay textures
+static const char *quadVertexShader =
+    "attribute vec2 vertex;\n"
+    "varying vec2 pos;\n"
+    "void main() {\n"
+    "    pos = vertex * 0.5 + 0.5;\n"
+    "    gl_Position = vec4(vertex, 0.0, 1.0);\n"
+    "}\n";
+
+// Persistence covers the plot with the histogram texture. Level 0
+// is the bottom of the plot and empty levels show the background.
+static const char *persistFragmentShader =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "uniform sampler2D hist;\n"
+    "uniform sampler2D palette;\n"
+    "uniform vec4 background;\n"
+    "varying vec2 pos;\n"
+    "void main() {\n"
+    "    float v = texture2D(hist, pos).r;\n"
+    "    vec4 c = texture2D(palette, vec2((1.0 - v) * 0.99609375 + 0.001953125, 0.5));\n"
+    "    gl_FragColor = mix(background, c, clamp(v * 4.0, 0.0, 1.0));\n"
+    "}\n";
+
+// Overlay image rows are top down
+static const char *overlayFragmentShader =
+    "#ifdef GL_ES\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "uniform sampler2D overlay;\n"
+    "varying vec2 pos;\n"
+    "void main() {\n"
+    "    gl_FragColor = texture2D(overlay, vec2(pos.x, 1.0 - pos.y));\n"
+    "}\n";
+
+static const GLfloat quad[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+
+void SpectrumPlot::initializeGL()
+{
+    initializeOpenGLFunctions();
+    program = new QOpenGLShaderProgram();
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader);
+    program->bindAttributeLocation("vertex", 0);
+    if (!program->link()) qWarning() << "SpectrumPlot" << program->log();
+    vbo.create();
+    vbo.setUsagePattern(QOpenGLBuffer::DynamicDraw);
+    verticesChanged = true;
+
+    persistProgram = new QOpenGLShaderProgram();
+    persistProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, quadVertexShader);
+    persistProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, persistFragmentShader);
+    persistProgram->bindAttributeLocation("vertex", 0);
+    if (!persistProgram->link()) qWarning() << "SpectrumPlot" << persistProgram->log();
+    overlayProgram = new QOpenGLShaderProgram();
+    overlayProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, quadVertexShader);
+    overlayProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, overlayFragmentShader);
+    overlayProgram->bindAttributeLocation("vertex", 0);
+    if (!overlayProgram->link()) qWarning() << "SpectrumPlot" << overlayProgram->log();
+    glGenTextures(1, &persistTexture);
+    glGenTextures(1, &paletteTexture);
+    glGenTextures(1, &overlayTexture);
+    for (GLuint tex : {persistTexture, paletteTexture, overlayTexture}) {
+        glBindTexture(GL_TEXTURE_2D, tex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    persistWidth = 0;
+    persistChanged = true;
+    paletteChanged = true;
+    overlayChanged = true;
 }
 
-void SpectrumPlot::setData(QVector<qreal> *vals)
+// Any number of queued updates may arrive for the same frame.
+void SpectrumPlot::setData(ViewFrames *f)
 {
-    if (vals->size() + 4 != polyData.size()) {
-        polyData.resize(vals->size() + 4);
-        for (int x = 0, xx = vals->size(); x < xx; ++x) {
-            polyData[x].setX(x);
+    frames = f;
+    if (!frames->update()) return;
+    const QVector<REAL> &vals = frames->front().points;
+    if (vals.isEmpty()) return;
+    if (vals.size() != points) {
+        points = vals.size();
+        vertices.resize(points * 4);
+        for (int x = 0; x < points; ++x) {
+            vertices[x*4] = x;
+            vertices[x*4+2] = x;
+            vertices[x*4+3] = -1000;
         }
     }
-    int x = 0;
-    for (int xx = vals->size(); x < xx; ++x) {
-        polyData[x].setY(-(*vals)[x]);
+    for (int x = 0; x < points; ++x) {
+        vertices[x*4+1] = vals[x];
+    }
+    verticesChanged = true;
+    // Auto scale follows the floor across what is shown
+    const QVector<REAL> &floor = frames->front().floor;
+    floorWork.resize(floor.size());
+    std::copy(floor.constBegin(), floor.constEnd(), floorWork.begin());
+    if (!floorWork.isEmpty()) {
+        auto mid = floorWork.begin() + floorWork.size() / 2;
+        std::nth_element(floorWork.begin(), mid, floorWork.end());
+        setNoiseFloor(*mid);
     }
-    polyData[x] = QPointF(x+1,polyData[x-1].y());
-    polyData[x+1] = QPointF(x+1,1000);
-    polyData[x+2] = QPointF(-2,1000);
-    polyData[x+3] = QPointF(-2,polyData[0].y());
     update();
 }
 
+void SpectrumPlot::setPersistence(bool p)
+{
+    persistence = p;
+    update();
+}
+
+// Uploaded straight from the front buffer at the next paint
+void SpectrumPlot::setPersistenceData(PersistenceFrames *f)
+{
+    persistFrames = f;
+    if (!persistFrames->update()) return;
+    persistChanged = true;
+    update();
+}
+
+void SpectrumPlot::setSignalList(QVector<CwSignal> list)
+{
+    signalList = list;
+}
+
 void SpectrumPlot::setFilter(int hz)
 {
     // Add fudge for filter rolloff
     filter = hz + 75;
+    needsRecalc = true;
     update();
 }
 
 void SpectrumPlot::setDbOffset(qreal db)
 {
-    setMinDb(-130 + db);
+    manualMinDb = -130 + db;
+    if (!autoScale) setMinDb(manualMinDb);
+}
+
+void SpectrumPlot::setAutoScale(bool a)
+{
+    autoScale = a;
+    if (!autoScale) setMinDb(manualMinDb);
+    else setNoiseFloor(noiseFloor);
+}
+
+void SpectrumPlot::setNoiseFloor(qreal db)
+{
+    noiseFloor = db;
+    if (!autoScale || noiseFloor < -300) return;
+    int target = qFloor(noiseFloor) - AUTO_MARGIN_DB;
+    if (abs(target - minDb) >= AUTO_HYSTERESIS_DB) setMinDb(target);
 }
 
 void SpectrumPlot::setXit(qint64 f)
 {
     xit = f;
+    needsRecalc = true;
+    update();
 }
 
 void SpectrumPlot::setRit(qint64 f)
 {
     rit = f;
+    needsRecalc = true;
+    update();
 }
 
 void SpectrumPlot::setXitRitEnabled(int v)
 {
     xitrit = v;
+    needsRecalc = true;
+    update();
+}
+
+void SpectrumPlot::paintPersistence()
+{
+    if (!persistProgram->bind()) return;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, persistTexture);
+    if (persistChanged) {
+        persistChanged = false;
+        const QVector<quint8> &hist = persistFrames->front();
+        int w = hist.size() / PERSISTLEVELS;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (w != persistWidth) {
+            persistWidth = w;
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, w, PERSISTLEVELS, 0,
+                         GL_LUMINANCE, GL_UNSIGNED_BYTE, hist.constData());
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, PERSISTLEVELS,
+                            GL_LUMINANCE, GL_UNSIGNED_BYTE, hist.constData());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    if (paletteChanged) {
+        paletteChanged = false;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PALETTE, 1, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, paletteData.constData());
+    }
+    glActiveTexture(GL_TEXTURE0);
+    persistProgram->setUniformValue("hist", 0);
+    persistProgram->setUniformValue("palette", 1);
+    persistProgram->setUniformValue("background", QVector4D(background.redF(), background.greenF(),
+                                                            background.blueF(), 1));
+    QOpenGLBuffer::release(QOpenGLBuffer::VertexBuffer);
+    persistProgram->enableAttributeArray(0);
+    persistProgram->setAttributeArray(0, GL_FLOAT, quad, 2);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    persistProgram->disableAttributeArray(0);
+    persistProgram->release();
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Zoom of 0 is the full 96 kHz, otherwise 30 kHz divided by zoom.
+qreal SpectrumPlot::spanHz() const
+{
+    if (!zoom) return 96000.0;
+    return 30000.0 / zoom;
 }
 
-void SpectrumPlot::paintEvent(QPaintEvent *event)
+// Receive frequency is centered except in the full view
+// where the plot starts 24 kHz below it.
+qreal SpectrumPlot::rxX() const
 {
+    if (!zoom) return width() * 0.25;
+    return width() * 0.5;
+}
+
+void SpectrumPlot::paintGL()
+{
+    QElapsedTimer paintTimer;
+    paintTimer.start();
     if (needsRecalc) {
         needsRecalc = false;
-        delete labels;
-        qreal yscale = (qreal)rect().height() / rangeDb;
-        auto ft = font();
-        ft.setPixelSize(11);
-        QFontMetrics fontMetrics(ft);
-        auto lineWidth = fontMetrics.size(Qt::TextSingleLine, "-000").width();
-        labels = new QPixmap(lineWidth, height());
-        labels->fill(Qt::transparent);
-        if (height()) {
-            QPainter p(labels);
-            p.setFont(ft);
-            p.setPen(dbText);
-            int fh = fontMetrics.height();
-            stepSize = rangeDb;
-            if (yscale > fh) stepSize = 1;
-            else if (yscale * 5 > fh) stepSize = 5;
-            else if (yscale * 10 > fh) stepSize = 10;
-            else if (yscale * 25 > fh) stepSize = 25;
-            else if (yscale * 50 > fh) stepSize = 50;
-            qreal fontOffset = fontMetrics.tightBoundingRect("0").height() * 0.5;
-            qreal y = -(minDb + rangeDb) - stepSize;
-            while ((int)y%stepSize) ++y;
-            firstLine = y;
-            while (y < -minDb + stepSize) {
-                qreal yy = (y + minDb + rangeDb) * yscale;
-                p.drawText(0, yy + fontOffset, QString::number(-y));
-                y += stepSize;
-            }
+        updateOverlay();
+    }
+
+    glClearColor(background.redF(), background.greenF(), background.blueF(), 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    const bool persisting = persistence && persistFrames && !persistFrames->front().isEmpty();
+    if (persisting) paintPersistence();
+    if (points > 1 && program->bind()) {
+        vbo.bind();
+        if (verticesChanged) {
+            verticesChanged = false;
+            int bytes = vertices.size() * sizeof(GLfloat);
+            if (vbo.size() != bytes) vbo.allocate(vertices.constData(), bytes);
+            else vbo.write(0, vertices.constData(), bytes);
         }
+        QVector4D stopColor[GRADIENT_STOPS];
+        GLfloat stopPos[GRADIENT_STOPS];
+        for (int i = 0; i < GRADIENT_STOPS; ++i) {
+            // Two stop themes repeat the last stop
+            const auto &stop = intensity[qMin(i, intensity.size() - 1)];
+            const QColor &c = stop.second;
+            stopColor[i] = QVector4D(c.redF(), c.greenF(), c.blueF(), 1);
+            stopPos[i] = (i && stop.first <= stopPos[i-1]) ? stopPos[i-1] + 1e-3 : stop.first;
+        }
+        program->setUniformValue("count", (GLfloat)(points - 1));
+        program->setUniformValue("minDb", (GLfloat)minDb);
+        program->setUniformValue("rangeDb", (GLfloat)rangeDb);
+        program->setUniformValue("height", (GLfloat)(height() * devicePixelRatio()));
+        program->setUniformValueArray("stopColor", stopColor, GRADIENT_STOPS);
+        program->setUniformValueArray("stopPos", stopPos, GRADIENT_STOPS, 1);
+        program->enableAttributeArray(0);
+        // Fill is a strip down to the bottom edge
+        if (!persisting) {
+            program->setUniformValue("lineColor", QVector4D(0, 0, 0, 0));
+            program->setAttributeBuffer(0, GL_FLOAT, 0, 2);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, points * 2);
+        }
+        // Trace is every other vertex
+        program->setUniformValue("lineColor", QVector4D(plotLine.redF(), plotLine.greenF(),
+                                                        plotLine.blueF(), 1));
+        program->setAttributeBuffer(0, GL_FLOAT, 0, 2, 4 * sizeof(GLfloat));
+        glDrawArrays(GL_LINE_STRIP, 0, points);
+        program->disableAttributeArray(0);
+        vbo.release();
+        program->release();
     }
-    int topStart = minDb + rangeDb;
-    makeCurrent();
-    QPainter p(this);
-    p.fillRect(rect(), background);
-    qreal xscale = (qreal)rect().width() / (polyData.size()-4);
-    qreal yscale = (qreal)rect().height() / rangeDb;
-    qreal xoffset = 0;
-    if (zoom && xscale < 1.0) {
-        xoffset = -((polyData.size()-4) - (qreal)rect().width())/2;
-        xscale = 1.0;
+
+    // Grid, labels and markers are one premultiplied texture
+    if (!overlay.isNull() && overlayProgram->bind()) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, overlayTexture);
+        if (overlayChanged) {
+            overlayChanged = false;
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, overlay.width(), overlay.height(), 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, overlay.constBits());
+        }
+        overlayProgram->setUniformValue("overlay", 0);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        QOpenGLBuffer::release(QOpenGLBuffer::VertexBuffer);
+        overlayProgram->enableAttributeArray(0);
+        overlayProgram->setAttributeArray(0, GL_FLOAT, quad, 2);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        overlayProgram->disableAttributeArray(0);
+        glDisable(GL_BLEND);
+        overlayProgram->release();
+        glBindTexture(GL_TEXTURE_2D, 0);
     }
-    p.scale(xscale, yscale);
-    p.translate(xoffset, topStart);
-    QPen polypen(plotLine);
-    polypen.setWidth(0);
-    QLinearGradient grad(0, -topStart, 0, -minDb);
-    grad.setStops(intensity);
-    p.setBrush(grad);
-    p.setPen(polypen);
-    p.drawPolygon(polyData.data(), polyData.size());
-    p.setWorldTransform(QTransform()); // reset
+
+    if (finishPaint) glFinish();
+    lastPaintNs = paintTimer.nsecsElapsed();
+}
+
+// Everything drawn over the trace that only changes with the
+// scale, filter, XIT/RIT, theme, zoom or size. The image is
+// premultiplied RGBA in device pixels with row 0 at the top.
+void SpectrumPlot::updateOverlay()
+{
+    const qreal dpr = devicePixelRatio();
+    overlay = QImage(width() * dpr, height() * dpr, QImage::Format_RGBA8888_Premultiplied);
+    overlay.setDevicePixelRatio(dpr);
+    overlay.fill(Qt::transparent);
+    overlayChanged = true;
+    if (!height() || !width()) return;
+    QPainter p(&overlay);
+
+    const int topStart = minDb + rangeDb;
+    const qreal yscale = (qreal)height() / rangeDb;
+    auto ft = font();
+    ft.setPixelSize(11);
+    QFontMetrics fontMetrics(ft);
+    int fh = fontMetrics.height();
+    int stepSize = rangeDb;
+    if (yscale > fh) stepSize = 1;
+    else if (yscale * 5 > fh) stepSize = 5;
+    else if (yscale * 10 > fh) stepSize = 10;
+    else if (yscale * 25 > fh) stepSize = 25;
+    else if (yscale * 50 > fh) stepSize = 50;
+    int firstLine = -topStart - stepSize;
+    while (firstLine % stepSize) ++firstLine;
     p.setPen(dbLine);
     for (int y = firstLine; y < -minDb + stepSize; y += stepSize) {
         int yy = (y + topStart) * yscale;
         p.drawLine(0, yy, width(), yy);
     }
-    p.drawPixmap(2, 0, *labels);
+    p.setFont(ft);
+    p.setPen(dbText);
+    qreal fontOffset = fontMetrics.tightBoundingRect("0").height() * 0.5;
+    for (int y = firstLine; y < -minDb + stepSize; y += stepSize) {
+        qreal yy = (y + topStart) * yscale;
+        p.drawText(2, yy + fontOffset, QString::number(-y));
+    }
 
-    const qreal binSize = 96000.0 / 8192;
+    const qreal hzPerPixel = spanHz() / width();
 
-    p.scale(xscale, 1.0);
-    p.translate(xoffset, 0);
     QColor filterColor(Qt::yellow);
     filterColor.setAlpha(33);
     QRectF filterRect(rect());
-    qreal filterWidth = filter / binSize;
-    filterRect.setX(polyData.size() / 2.0 - filterWidth / 2.0 - 1);
+    qreal filterWidth = filter / hzPerPixel;
+    filterRect.setX(rxX() - filterWidth / 2.0);
     filterRect.setWidth(filterWidth);
     p.fillRect(filterRect, filterColor);
 
     if (xitrit) {
-        qreal transmitX = polyData.size() / 2.0 - 2.0 + (xit - rit) / binSize;
+        qreal transmitX = rxX() - 1.0 + (xit - rit) / hzPerPixel;
         QColor transmitColor(Qt::red);
         transmitColor.setAlpha(75);
         QRectF transmitRect(rect());
         transmitRect.setX(transmitX);
-        transmitRect.setWidth(1/xscale * 2);
+        transmitRect.setWidth(2);
         p.fillRect(transmitRect, transmitColor);
     }
-
-    event->accept();
-    // eat event
 }
 
 void SpectrumPlot::resizeEvent(QResizeEvent *event)
 {
-    if (height() != labels->height()) {
-        needsRecalc = true;
-        update();
+    needsRecalc = true;
+    update();
+    if (event->size().width() != event->oldSize().width()) {
+        emit widthChanged(event->size().width());
     }
-    QGLWidget::resizeEvent(event);
+    QOpenGLWidget::resizeEvent(event);
 }
 
 void SpectrumPlot::mousePressEvent(QMouseEvent *event) {
     if (event->button() == Qt::LeftButton || event->button() == Qt::RightButton) {
-        qreal xscale = (qreal)rect().width() / (polyData.size()-4);
-        qreal xoffset = 0;
-        if (zoom && xscale < 1.0) {
-            xoffset = -((polyData.size()-4) - (qreal)rect().width())/2;
-            xscale = 1.0;
+        const qreal hzPerPixel = spanHz() / width();
+        qreal adj = (event->pos().x() - rxX()) * hzPerPixel;
+        qreal snap = SNAP_HZ;
+        for (const auto &sig : signalList) {
+            if (std::abs(sig.offset - adj) < snap) {
+                snap = std::abs(sig.offset - adj);
+                adj = sig.offset;
+            }
         }
-        const qreal binSize = 96000.0 / 8192;
-        qreal adj = binSize * ((event->pos().x()-1) / xscale - xoffset) - 15000;
         if (event->button() == Qt::LeftButton) emit freqAdjusted(adj);
         else emit offsetAdjusted(adj);
         event->accept();
     }
-    QGLWidget::mousePressEvent(event);
+    QOpenGLWidget::mousePressEvent(event);
+}
+
+void SpectrumPlot::showEvent(QShowEvent *event)
+{
+    // The top level window reports minimize and exposure
+    window()->installEventFilter(this);
+    if (window()->windowHandle()) window()->windowHandle()->installEventFilter(this);
+    updateVisible();
+    QOpenGLWidget::showEvent(event);
+}
+
+void SpectrumPlot::hideEvent(QHideEvent *event)
+{
+    updateVisible();
+    QOpenGLWidget::hideEvent(event);
+}
+
+bool SpectrumPlot::eventFilter(QObject *obj, QEvent *event)
+{
+    if (event->type() == QEvent::Expose ||
+        event->type() == QEvent::WindowStateChange) {
+        updateVisible();
+    }
+    return QOpenGLWidget::eventFilter(obj, event);
+}
+
+// Not visible when hidden, minimized or the platform says the
+// window is fully covered.
+void SpectrumPlot::updateVisible()
+{
+    bool v = isVisible() && !window()->isMinimized();
+    QWindow *w = window()->windowHandle();
+    if (w && !w->isExposed()) v = false;
+    if (v != viewVisible) {
+        viewVisible = v;
+        emit visibilityChanged(v);
+    }
 }
 
 QSize SpectrumPlot::sizeHint() const
@@ -205,63 +555,101 @@ QSize SpectrumPlot::sizeHint() const
     return QSize(300,150);
 }
 
+QGradientStops SpectrumPlot::gradient(int v)
+{
+    QGradientStops stops;
+    switch((Theme)v) {
+    case Theme::Linrad:
+        stops.push_back(QPair<double, QColor>(0.0, QColor("#ff0000")));
+        stops.push_back(QPair<double, QColor>(0.5, QColor("#008020")));
+        stops.push_back(QPair<double, QColor>(1.0, QColor("#000030")));
+        break;
+    case Theme::Grayscale:
+        stops.push_back(QPair<double, QColor>(0.0, QColor("#f0f0f0")));
+        stops.push_back(QPair<double, QColor>(1.0, QColor("#000000")));
+        break;
+    case Theme::Spectran:
+        stops.push_back(QPair<double, QColor>(0.0, QColor("#f0f0f0")));
+        stops.push_back(QPair<double, QColor>(0.5, QColor("#5080d0")));
+        stops.push_back(QPair<double, QColor>(1.0, QColor("#000030")));
+        break;
+    case Theme::SpectranExtended:
+        stops.push_back(QPair<double, QColor>(0.0, QColor("#ffff48")));
+        stops.push_back(QPair<double, QColor>(0.5, QColor("#A00080")));
+        stops.push_back(QPair<double, QColor>(1.0, QColor("#100080")));
+        break;
+    case Theme::Horne:
+        stops.push_back(QPair<double, QColor>(0.0, QColor("#ffff48")));
+        stops.push_back(QPair<double, QColor>(0.5, QColor("#00ffff")));
+        stops.push_back(QPair<double, QColor>(1.0, QColor("#2600f8")));
+        break;
+    default: // (#0) Winrad
+        stops.push_back(QPair<double, QColor>(0.0, QColor("#ff0000")));
+        stops.push_back(QPair<double, QColor>(0.5, QColor("#008000")));
+        stops.push_back(QPair<double, QColor>(1.0, QColor("#000080")));
+        break;
+    }
+    return stops;
+}
+
+// RGBA lookup table where entry 0 is the top of the gradient
+QVector<GLubyte> SpectrumPlot::gradientTable(int theme, int entries)
+{
+    QGradientStops stops = gradient(theme);
+    QVector<GLubyte> table(entries * 4);
+    int s = 0;
+    for (int i = 0; i < entries; ++i) {
+        qreal p = (qreal)i / (entries - 1);
+        while (s < stops.size() - 2 && p > stops[s+1].first) ++s;
+        const auto &a = stops[s];
+        const auto &b = stops[qMin(s + 1, stops.size() - 1)];
+        qreal f = 0;
+        if (b.first > a.first) f = qBound(0.0, (p - a.first) / (b.first - a.first), 1.0);
+        table[i*4] = qRound(a.second.red() + (b.second.red() - a.second.red()) * f);
+        table[i*4+1] = qRound(a.second.green() + (b.second.green() - a.second.green()) * f);
+        table[i*4+2] = qRound(a.second.blue() + (b.second.blue() - a.second.blue()) * f);
+        table[i*4+3] = 0xff;
+    }
+    return table;
+}
+
 void SpectrumPlot::setTheme(int v)
 {
+    intensity = gradient(v);
+    paletteData = gradientTable(v, PALETTE);
+    paletteChanged = true;
     switch((Theme)v) {
     case Theme::Linrad:
-        intensity.clear();
-        intensity.push_back(QPair<double, QColor>(0.0, QColor("#ff0000")));
-        intensity.push_back(QPair<double, QColor>(0.5, QColor("#008020")));
-        intensity.push_back(QPair<double, QColor>(1.0, QColor("#000030")));
         background.setNamedColor("#000000");
         plotLine.setNamedColor("#808080");
         dbLine.setNamedColor("#292761");
         dbText.setNamedColor("#DDDDDD");
         break;
     case Theme::Grayscale:
-        intensity.clear();
-        intensity.push_back(QPair<double, QColor>(0.0, QColor("#f0f0f0")));
-        intensity.push_back(QPair<double, QColor>(1.0, QColor("#000000")));
         background.setNamedColor("#000000");
         plotLine.setNamedColor("#808080");
         dbLine.setNamedColor("#282828");
         dbText.setNamedColor("#DDDDDD");
         break;
     case Theme::Spectran:
-        intensity.clear();
-        intensity.push_back(QPair<double, QColor>(0.0, QColor("#f0f0f0")));
-        intensity.push_back(QPair<double, QColor>(0.5, QColor("#5080d0")));
-        intensity.push_back(QPair<double, QColor>(1.0, QColor("#000030")));
         background.setNamedColor("#000000");
         plotLine.setNamedColor("#808080");
         dbLine.setNamedColor("#292761");
         dbText.setNamedColor("#DDDDDD");
         break;
     case Theme::SpectranExtended:
-        intensity.clear();
-        intensity.push_back(QPair<double, QColor>(0.0, QColor("#ffff48")));
-        intensity.push_back(QPair<double, QColor>(0.5, QColor("#A00080")));
-        intensity.push_back(QPair<double, QColor>(1.0, QColor("#100080")));
         background.setNamedColor("#000000");
         plotLine.setNamedColor("#808080");
         dbLine.setNamedColor("#292761");
         dbText.setNamedColor("#DDDDDD");
         break;
     case Theme::Horne:
-        intensity.clear();
-        intensity.push_back(QPair<double, QColor>(0.0, QColor("#ffff48")));
-        intensity.push_back(QPair<double, QColor>(0.5, QColor("#00ffff")));
-        intensity.push_back(QPair<double, QColor>(1.0, QColor("#2600f8")));
         background.setNamedColor("#000000");
         plotLine.setNamedColor("#808080");
         dbLine.setNamedColor("#292761");
         dbText.setNamedColor("#DDDDDD");
         break;
     default: // (#0) Winrad
-        intensity.clear();
-        intensity.push_back(QPair<double, QColor>(0.0, QColor("#ff0000")));
-        intensity.push_back(QPair<double, QColor>(0.5, QColor("#008000")));
-        intensity.push_back(QPair<double, QColor>(1.0, QColor("#000080")));
         background.setNamedColor("#020131");
         plotLine.setNamedColor("#808080");
         dbLine.setNamedColor("#2a2561");
@@ -272,9 +660,10 @@ void SpectrumPlot::setTheme(int v)
     update();
 }
 
-void SpectrumPlot::setZoom(bool z)
+void SpectrumPlot::setZoom(int z)
 {
-    zoom = z;
+    zoom = qMax(0, z);
+    needsRecalc = true;
     update();
 }
 
@@ -283,6 +672,7 @@ void SpectrumPlot::setMinDb(int v)
     minDb = v;
     needsRecalc = true;
     update();
+    emit scaleChanged(minDb, rangeDb);
 }
 
 void SpectrumPlot::setRangeDb(int v)
@@ -290,4 +680,5 @@ void SpectrumPlot::setRangeDb(int v)
     rangeDb = v;
     needsRecalc = true;
     update();
+    emit scaleChanged(minDb, rangeDb);
 }
@@ -18,11 +18,17 @@
 #define SPECTRUMPLOT_H
 
 #include <QtCore>
-#include <QGLWidget>
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include <QOpenGLBuffer>
+#include "dsp.h"
+#include "detector.h"
+#include "triplebuffer.h"
 
-class SpectrumPlot : public QGLWidget
+class SpectrumPlot : public QOpenGLWidget, protected QOpenGLFunctions
 {
     Q_OBJECT
+    friend class PlotBenchmark;
 public:
     explicit SpectrumPlot(QWidget *parent);
     ~SpectrumPlot();
@@ -34,17 +40,28 @@ public:
         SpectranExtended,
         Horne
     };
+    // Theme colors from strongest to weakest signal
+    static QGradientStops gradient(int theme);
+    static QVector<GLubyte> gradientTable(int theme, int entries);
 
 signals:
     void freqAdjusted(qreal delta);
     void offsetAdjusted(qreal delta);
+    void widthChanged(int pixels);
+    void visibilityChanged(bool visible);
+    void scaleChanged(int minDb, int rangeDb);
 
 public slots:
     void setTheme(int v);
-    void setZoom(bool z);
+    void setZoom(int z);
+    void setAutoScale(bool a);
+    void setNoiseFloor(qreal db);
+    void setSignalList(QVector<CwSignal> list);
     void setMinDb(int v);
     void setRangeDb(int v);
-    void setData(QVector<qreal> * vals);
+    void setData(ViewFrames *frames);
+    void setPersistence(bool p);
+    void setPersistenceData(PersistenceFrames *frames);
     void setFilter(int hz);
     void setDbOffset(qreal db);
     void setXit(qint64 f);
@@ -53,11 +70,32 @@ public slots:
     virtual QSize sizeHint() const;
 
 protected:
-    void paintEvent(QPaintEvent *event);
+    void initializeGL();
+    void paintGL();
     void resizeEvent(QResizeEvent * event);
     void mousePressEvent(QMouseEvent * event);
+    void showEvent(QShowEvent *event);
+    void hideEvent(QHideEvent *event);
+    bool eventFilter(QObject *obj, QEvent *event);
 
 private:
+    // Auto scale keeps the noise floor this far above the bottom
+    static const int AUTO_MARGIN_DB = 10;
+    static const int AUTO_HYSTERESIS_DB = 3;
+    // Clicks this close to a detected signal tune to it
+    static constexpr qreal SNAP_HZ = 60;
+
+    // Gradient fill is computed from three theme stops
+    static const int GRADIENT_STOPS = 3;
+    // Entries in the persistence color lookup texture
+    static const int PALETTE = 256;
+
+    qreal spanHz() const;
+    qreal rxX() const;
+    void updateVisible();
+    void paintPersistence();
+    void updateOverlay();
+
     QGradientStops intensity;
     QColor background;
     QColor plotLine;
@@ -66,16 +104,44 @@ private:
     int rangeDb;
     int minDb;
     int filter;
-    bool zoom;
+    int zoom;
+    bool autoScale;
+    int manualMinDb;
+    qreal noiseFloor;
     bool needsRecalc;
     qint64 xit;
     qint64 rit;
     bool xitrit;
 
-    QPixmap *labels;
-    int stepSize;
-    int firstLine;
-    QVector<QPointF> polyData;
+    // Grid, labels, filter and XIT/RIT markers
+    QImage overlay;
+    bool overlayChanged;
+    GLuint overlayTexture;
+    class QOpenGLShaderProgram *overlayProgram;
+    // Two vertices per point, the trace and the bottom edge
+    QVector<GLfloat> vertices;
+    int points;
+    bool verticesChanged;
+    QOpenGLBuffer vbo;
+    class QOpenGLShaderProgram *program;
+    // Persistence histogram replaces the gradient fill
+    bool persistence;
+    bool persistChanged;
+    int persistWidth;
+    PersistenceFrames *persistFrames;
+    QVector<GLubyte> paletteData;
+    bool paletteChanged;
+    GLuint persistTexture;
+    GLuint paletteTexture;
+    class QOpenGLShaderProgram *persistProgram;
+    QVector<CwSignal> signalList;
+    ViewFrames *frames;
+    // Scratch for the median of the frame's noise floor
+    QVector<REAL> floorWork;
+    bool viewVisible;
+    qint64 lastPaintNs;
+    // Include GPU time in lastPaintNs
+    bool finishPaint;
 
 };
 
@@ -0,0 +1,96 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <QtCore>
+#include "dsp.h"
+
+// Lock-free hand off of whole frames from one writer thread to one
+// reader thread. The writer fills back() and calls publish(). The
+// reader calls update() and then uses front() until the next update.
+// Neither side ever waits and the reader always gets the newest
+// complete frame. A frame published before the reader took the
+// previous one is dropped and counted.
+
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() :
+        middle(1),
+        writeIndex(0),
+        readIndex(2),
+        m_published(0),
+        m_dropped(0)
+    {
+    }
+
+    // Writer side
+    inline T &back() {
+        return buffers[writeIndex];
+    }
+    void publish() {
+        int old = middle.fetchAndStoreOrdered(writeIndex | FRESH);
+        writeIndex = old & INDEX;
+        m_published.fetchAndAddRelaxed(1);
+        if (old & FRESH) m_dropped.fetchAndAddRelaxed(1);
+    }
+
+    // Reader side, returns false if there is nothing new
+    bool update() {
+        if (!(middle.loadAcquire() & FRESH)) return false;
+        readIndex = middle.fetchAndStoreOrdered(readIndex) & INDEX;
+        return true;
+    }
+    inline const T &front() const {
+        return buffers[readIndex];
+    }
+
+    // Instrumentation, safe from any thread
+    inline quint32 published() const {
+        return m_published.load();
+    }
+    inline quint32 dropped() const {
+        return m_dropped.load();
+    }
+
+private:
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+
+    T buffers[3];
+    QAtomicInt middle;
+    int writeIndex;
+    int readIndex;
+    QAtomicInteger<quint32> m_published;
+    QAtomicInteger<quint32> m_dropped;
+};
+
+// Spectrum to SpectrumPlot, the trace and the local noise floor
+// under each point, both in dB
+struct SpectrumView {
+    QVector<REAL> points;
+    QVector<REAL> floor;
+};
+typedef TripleBuffer<SpectrumView> ViewFrames;
+// Spectrum to WaterfallPlot
+typedef TripleBuffer<QVector<REAL>> SpectrumFrames;
+// Persistence histogram, PERSISTLEVELS rows from the bottom of the plot
+typedef TripleBuffer<QVector<quint8>> PersistenceFrames;
+
+#endif // TRIPLEBUFFER_H
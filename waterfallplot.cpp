@@ -0,0 +1,238 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "waterfallplot.h"
+#include "spectrumplot.h"
+#include "bins.h"
+#include <QDebug>
+#include <QOpenGLBuffer>
+#include <QOpenGLShaderProgram>
+
+const int WaterfallPlot::HISTORY;
+
+WaterfallPlot::WaterfallPlot(QWidget *parent) :
+    QOpenGLWidget(parent)
+{
+    minDb = -100;
+    rangeDb = 110;
+    lineWidth = 0;
+    maxWidth = 2048;
+    head = HISTORY - 1;
+    allocate = true;
+    pendingLines = 0;
+    paletteChanged = true;
+    lineTexture = 0;
+    paletteTexture = 0;
+    program = nullptr;
+    setTheme((int)SpectrumPlot::Theme::Winrad);
+    setAttribute(Qt::WA_OpaquePaintEvent, true);
+}
+
+WaterfallPlot::~WaterfallPlot()
+{
+    makeCurrent();
+    if (lineTexture) glDeleteTextures(1, &lineTexture);
+    if (paletteTexture) glDeleteTextures(1, &paletteTexture);
+    delete program;
+    doneCurrent();
+}
+
+static const char *vertexShader =
+    "attribute vec2 vertex;\n"
+    "varying vec2 pos;\n"
+    "void main() {\n"
+    "    pos = vertex * 0.5 + 0.5;\n"
+    "    gl_Position = vec4(vertex, 0.0, 1.0);\n"
+    "}\n";
+
+// The newest line is at the top. Lines are 16 bit values in the
+// red and green bytes which become an index into the palette.
+static const char *fragmentShader =
+    "#ifdef GL_ES\n"
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+    "precision highp float;\n"
+    "#else\n"
+    "precision mediump float;\n"
+    "#endif\n"
+    "#endif\n"
+    "uniform sampler2D lines;\n"
+    "uniform sampler2D palette;\n"
+    "uniform float head;\n"
+    "uniform float shown;\n"
+    "uniform float dbBase;\n"
+    "uniform float dbSpan;\n"
+    "uniform float minDb;\n"
+    "uniform float rangeDb;\n"
+    "varying vec2 pos;\n"
+    "void main() {\n"
+    "    float row = fract(head - (1.0 - pos.y) * shown);\n"
+    "    vec4 texel = texture2D(lines, vec2(pos.x, row));\n"
+    "    float db = (texel.r * 65280.0 + texel.g * 255.0) / 65535.0 * dbSpan + dbBase;\n"
+    "    float t = clamp((db - minDb) / rangeDb, 0.0, 1.0);\n"
+    "    gl_FragColor = texture2D(palette, vec2((1.0 - t) * 0.99609375 + 0.001953125, 0.5));\n"
+    "}\n";
+
+static const GLfloat quad[] = {-1, -1, 1, -1, -1, 1, 1, 1};
+
+void WaterfallPlot::initializeGL()
+{
+    initializeOpenGLFunctions();
+    program = new QOpenGLShaderProgram();
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShader);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShader);
+    program->bindAttributeLocation("vertex", 0);
+    if (!program->link()) qWarning() << "WaterfallPlot" << program->log();
+    GLint max = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max);
+    if (max > 0) maxWidth = max;
+    glGenTextures(1, &lineTexture);
+    glGenTextures(1, &paletteTexture);
+    // Lines must not be filtered, the bytes are not independent
+    glBindTexture(GL_TEXTURE_2D, lineTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    allocate = true;
+    paletteChanged = true;
+}
+
+// Lines wait until the next paint in a ring laid out like the
+// texture, each in the row it will be uploaded to. While nothing
+// is painted the oldest row is overwritten once the ring is full.
+void WaterfallPlot::setData(SpectrumFrames *lines)
+{
+    if (!lines->update()) return;
+    const QVector<REAL> &vals = lines->front();
+    if (vals.isEmpty()) return;
+    int points = qMin(vals.size(), maxWidth);
+    if (points != lineWidth) {
+        lineWidth = points;
+        clear();
+    }
+    if (pendingLines == HISTORY) {
+        head = (head + 1) % HISTORY;
+        --pendingLines;
+    }
+    QVarLengthArray<REAL, 4096> line(lineWidth);
+    Bins::reduceMax(vals.constData(), vals.size(), line.data(), lineWidth);
+    int row = (head + 1 + pendingLines) % HISTORY;
+    GLubyte *out = pending.data() + row * lineWidth * 4;
+    for (int x = 0; x < lineWidth; ++x) {
+        int v = qBound(0, qRound((line[x] - DB_BASE) / DB_SPAN * 65535), 65535);
+        *out++ = v >> 8;
+        *out++ = v & 0xff;
+        *out++ = 0;
+        *out++ = 0xff;
+    }
+    ++pendingLines;
+    update();
+}
+
+// Rows after the current head are uploaded from the same
+// rows of the ring, in two parts when they wrap.
+void WaterfallPlot::uploadPending()
+{
+    glBindTexture(GL_TEXTURE_2D, lineTexture);
+    if (allocate) {
+        allocate = false;
+        QVector<GLubyte> empty(lineWidth * HISTORY * 4, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, lineWidth, HISTORY, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, empty.constData());
+    }
+    int remaining = pendingLines;
+    while (remaining) {
+        int row = (head + 1) % HISTORY;
+        int rows = qMin(remaining, HISTORY - row);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, row, lineWidth, rows,
+                        GL_RGBA, GL_UNSIGNED_BYTE, pending.constData() + row * lineWidth * 4);
+        remaining -= rows;
+        head = row + rows - 1;
+    }
+    pendingLines = 0;
+}
+
+void WaterfallPlot::paintGL()
+{
+    glClearColor(0, 0, 0, 1);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (!lineWidth || !program->bind()) return;
+
+    uploadPending();
+    if (paletteChanged) {
+        paletteChanged = false;
+        glBindTexture(GL_TEXTURE_2D, paletteTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, PALETTE, 1, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, paletteData.constData());
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, lineTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    // One texture row per device pixel
+    int rows = qMin(HISTORY, qRound(height() * devicePixelRatio()));
+    program->setUniformValue("lines", 0);
+    program->setUniformValue("palette", 1);
+    program->setUniformValue("head", (GLfloat)((head + 0.5) / HISTORY));
+    program->setUniformValue("shown", (GLfloat)rows / HISTORY);
+    program->setUniformValue("dbBase", (GLfloat)DB_BASE);
+    program->setUniformValue("dbSpan", (GLfloat)DB_SPAN);
+    program->setUniformValue("minDb", (GLfloat)minDb);
+    program->setUniformValue("rangeDb", (GLfloat)rangeDb);
+    QOpenGLBuffer::release(QOpenGLBuffer::VertexBuffer);
+    program->enableAttributeArray(0);
+    program->setAttributeArray(0, GL_FLOAT, quad, 2);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    program->disableAttributeArray(0);
+    program->release();
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void WaterfallPlot::clear()
+{
+    allocate = true;
+    pending.resize(lineWidth * HISTORY * 4);
+    pendingLines = 0;
+    update();
+}
+
+void WaterfallPlot::setScale(int min, int range)
+{
+    minDb = min;
+    rangeDb = qMax(1, range);
+    update();
+}
+
+void WaterfallPlot::setTheme(int v)
+{
+    paletteData = SpectrumPlot::gradientTable(v, PALETTE);
+    paletteChanged = true;
+    update();
+}
+
+QSize WaterfallPlot::sizeHint() const
+{
+    return QSize(300,150);
+}
@@ -0,0 +1,76 @@
+// Peaberry CW - Transceiver for Peaberry SDR
+// Copyright (C) 2015 David Turnbull AE9RB
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WATERFALLPLOT_H
+#define WATERFALLPLOT_H
+
+#include <QtCore>
+#include <QOpenGLWidget>
+#include <QOpenGLFunctions>
+#include "dsp.h"
+#include "triplebuffer.h"
+
+// Each line is written once into a row of a ring buffer texture
+// and the display scrolls by moving the texture coordinates.
+// Lines hold absolute dB so the scale and theme can change
+// without touching the history.
+
+class WaterfallPlot : public QOpenGLWidget, protected QOpenGLFunctions
+{
+    Q_OBJECT
+public:
+    explicit WaterfallPlot(QWidget *parent);
+    ~WaterfallPlot();
+
+public slots:
+    void setTheme(int v);
+    void setScale(int minDb, int rangeDb);
+    void setData(SpectrumFrames *lines);
+    void clear();
+    virtual QSize sizeHint() const;
+
+protected:
+    void initializeGL();
+    void paintGL();
+
+private:
+    // Rows of history kept in the texture
+    static const int HISTORY = 1024;
+    // Entries in the theme lookup texture
+    static const int PALETTE = 256;
+    // Lines are stored as 16 bits over this dB range
+    static constexpr qreal DB_BASE = -200;
+    static constexpr qreal DB_SPAN = 256;
+
+    void uploadPending();
+
+    int minDb;
+    int rangeDb;
+    int lineWidth;
+    int maxWidth;
+    int head;
+    bool allocate;
+    QVector<GLubyte> pending;
+    int pendingLines;
+    QVector<GLubyte> paletteData;
+    bool paletteChanged;
+    GLuint lineTexture;
+    GLuint paletteTexture;
+    class QOpenGLShaderProgram *program;
+
+};
+
+#endif // WATERFALLPLOT_H